@@ -0,0 +1,422 @@
+// Hash rate benchmarks for the SHA-256 and mining hot paths.
+//
+// Every case is run a few times untimed to warm caches and spin up
+// threads, then repeated and summarised by the median and 95th
+// percentile of its run times.  Results go to Benchmark.csv (one row
+// per case, readable by Plot.R) and optionally to a JSON file.
+//
+// Merkle root construction for a 64k transaction block is timed at each
+// thread count, to show how tree building scales across cores.
+//
+// Every mining strategy runs on the same blocks, so they can be compared
+// head to head; --strategy NAME limits the run to one of them.
+// --affinity POLICY (compact, scatter or physical) pins each mining
+// thread to a CPU of its own, and the CPUs used are recorded with the
+// results.  --trace FILE writes a Chrome trace of the whole run on exit.
+//
+// --check-allocations runs no benchmarks; instead it checks that mining
+// makes no heap allocations per attempt, and exits non-zero if any
+// strategy does.
+//
+// Usage: Benchmark [--reps N] [--warmup N] [--difficulty D]
+//                  [--blocks N] [--strategy NAME] [--affinity POLICY]
+//                  [--json FILE] [--trace FILE] [--check-allocations]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "affinity.h"
+#include "block_chain.h"
+#include "merkle.h"
+#include "sha256.h"
+#include "sha256_multi.h"
+#include "trace.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Heap allocations made while --check-allocations runs.  Counting is
+// off otherwise, so the timed runs don't contend on the counter.
+static atomic<bool> counting_allocations(false);
+static atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size)
+{
+	if (counting_allocations.load(memory_order_relaxed))
+	{
+		allocations.fetch_add(1, memory_order_relaxed);
+	}
+	if (void *p = malloc(size == 0 ? 1 : size))
+	{
+		return p;
+	}
+	throw bad_alloc();
+}
+
+// GCC takes the free() below for a mismatch with a new-expression once
+// it inlines the two, not knowing operator new is ours too.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+void operator delete(void *p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+struct bench_result
+{
+	string name;
+	// Mining strategy, or empty for the plain hashing cases.
+	string strategy;
+	unsigned int threads;
+	size_t input_bytes;
+	uint32_t difficulty;
+	size_t reps;
+	double median_secs;
+	double p95_secs;
+	// Hashes per second at the median run time.
+	double hashes_per_sec;
+	// The CPU each mining thread was pinned to, separated by ';', or
+	// empty if they weren't.
+	string placement;
+	// How often the mining threads took work from each other, per block.
+	double steals_per_block = 0;
+};
+
+struct bench_options
+{
+	size_t reps = 9;
+	size_t warmup = 2;
+	uint32_t difficulty = 4;
+	uint32_t blocks = 10;
+	// Empty runs every strategy.
+	string strategy;
+	affinity_policy affinity = affinity_policy::none;
+	string json;
+	bool check_allocations = false;
+};
+
+// Nearest-rank percentile of an already sorted list.
+static double percentile(const vector<double> &sorted, double pct)
+{
+	size_t rank = static_cast<size_t>(pct / 100.0 * sorted.size() + 0.5);
+	rank = min(max<size_t>(rank, 1), sorted.size());
+	return sorted[rank - 1];
+}
+
+// Runs one case.  run() does the work and returns how many hashes it
+// computed, which can differ between repetitions when mining.
+static bench_result measure(const bench_options &opts, const string &name, const string &strategy, unsigned int threads, size_t input_bytes, uint32_t difficulty, const function<uint64_t()> &run)
+{
+	for (size_t i = 0; i < opts.warmup; ++i)
+	{
+		run();
+	}
+
+	vector<double> times;
+	uint64_t total_hashes = 0;
+	for (size_t i = 0; i < opts.reps; ++i)
+	{
+		auto start = steady_clock::now();
+		total_hashes += run();
+		duration<double> diff = steady_clock::now() - start;
+		times.push_back(diff.count());
+	}
+	sort(times.begin(), times.end());
+
+	bench_result r;
+	r.name = name;
+	r.strategy = strategy;
+	r.threads = threads;
+	r.input_bytes = input_bytes;
+	r.difficulty = difficulty;
+	r.reps = opts.reps;
+	r.median_secs = percentile(times, 50.0);
+	r.p95_secs = percentile(times, 95.0);
+	r.hashes_per_sec = (static_cast<double>(total_hashes) / opts.reps) / r.median_secs;
+
+	cout << name << (strategy.empty() ? "" : " (" + strategy + ")") << " threads=" << threads << " bytes=" << input_bytes << " difficulty=" << difficulty
+		<< ": " << r.hashes_per_sec / 1e6 << " MH/s (median " << r.median_secs << "s, p95 " << r.p95_secs << "s)" << endl;
+	return r;
+}
+
+// One thread hashing a fixed input as fast as it can.
+static bench_result bench_sha256(const bench_options &opts, size_t input_bytes)
+{
+	const string input(input_bytes, 'x');
+	// Aim for a run of roughly 64 MB so each one takes a measurable time.
+	const uint64_t iterations = max<uint64_t>(1000, (64u << 20) / max<size_t>(input_bytes, 1));
+	return measure(opts, "sha256", "", 1, input_bytes, 0, [&]
+	{
+		size_t sink = 0;
+		for (uint64_t i = 0; i < iterations; ++i)
+		{
+			sink += sha256(input)[0];
+		}
+		// Stops the compiler throwing the loop away.
+		if (sink == 1)
+		{
+			cout << "";
+		}
+		return iterations;
+	});
+}
+
+// Builds the Merkle root of a block of leaves transactions of
+// leaf_bytes each.  Counts one hash per leaf and per parent node.
+static bench_result bench_merkle(const bench_options &opts, size_t leaves, size_t leaf_bytes, unsigned int threads)
+{
+	const vector<string> transactions(leaves, string(leaf_bytes, 'x'));
+	uint64_t nodes = 0;
+	for (size_t level = leaves; level > 1; level = (level + 1) / 2)
+	{
+		nodes += level;
+	}
+	nodes += 1;
+	return measure(opts, "merkle_root", "", threads, leaf_bytes, 0, [&]
+	{
+		sha256_digest root = merkle_root(transactions, threads);
+		// Stops the compiler throwing the work away.
+		if (root[0] == 1 && root[1] == 2)
+		{
+			cout << "";
+		}
+		return nodes;
+	});
+}
+
+// Mines the same run of blocks with one strategy on a given number of
+// threads, counting the attempts every thread made.  Not every strategy
+// searches the nonces in order, so the winning nonce alone can be far
+// off.  Steals are counted over the untimed runs as well.
+static bench_result bench_mine(const bench_options &opts, const string &name, unsigned int threads)
+{
+	// Created outside the timed runs, so pool start-up isn't counted.
+	auto strategy = make_strategy(name, threads);
+	uint64_t blocks = 0;
+	uint64_t steals = 0;
+	bench_result r = measure(opts, "mine_block", name, threads, 0, opts.difficulty, [&]
+	{
+		uint64_t attempts = 0;
+		string prev_hash;
+		for (uint32_t i = 1; i <= opts.blocks; ++i)
+		{
+			block b(i, string("Block ") + to_string(i) + string(" Data"));
+			b.prev_hash = prev_hash;
+			block_stats stats;
+			b.mine_block(opts.difficulty, *strategy, threads, vector<unsigned int>(), opts.affinity, &stats);
+			// Fall back on the nonce for a strategy that keeps no counters.
+			attempts += stats.workers.empty() ? b.get_nonce() : stats.attempts();
+			steals += stats.steals();
+			++blocks;
+			prev_hash = b.get_hash();
+		}
+		return attempts;
+	});
+	// The first threads places are the same ones mine_block hands out.
+	stringstream placement;
+	for (auto cpu : place_workers(opts.affinity, threads))
+	{
+		placement << (placement.tellp() > 0 ? ";" : "") << cpu;
+	}
+	r.placement = placement.str();
+	r.steals_per_block = blocks == 0 ? 0 : static_cast<double>(steals) / blocks;
+	return r;
+}
+
+// The machine as the affinity policies see it, e.g. "2 packages, 16
+// cores, 32 CPUs".
+static string describe_topology()
+{
+	const vector<cpu_location> &topology = machine_topology();
+	unsigned int packages = 0;
+	unsigned int cores = 0;
+	for (auto &c : topology)
+	{
+		packages = max(packages, c.package + 1);
+		if (c.thread == 0)
+			++cores;
+	}
+	stringstream ss;
+	ss << packages << " packages, " << cores << " cores, " << topology.size() << " CPUs";
+	return ss.str();
+}
+
+// Mines the same block at difficulty 1 and at the chosen difficulty
+// with each strategy, counting allocations.  The harder block takes
+// thousands of times more attempts, but starting threads, stats and
+// the result line cost the same for both, so the counts only differ if
+// the search loops allocate.  Returns false if any strategy's do.
+static bool check_allocations(const bench_options &opts, const vector<string> &strategies)
+{
+	bool ok = true;
+	counting_allocations.store(true);
+	for (auto &name : strategies)
+	{
+		auto strategy = make_strategy(name);
+		uint64_t counts[2];
+		uint64_t attempts[2];
+		const uint32_t difficulties[2] = { 1, max<uint32_t>(opts.difficulty, 2) };
+		// The first block warms up runtimes that allocate once, such as OpenMP's.
+		for (int run = -1; run < 2; ++run)
+		{
+			const uint32_t difficulty = difficulties[run < 0 ? 1 : run];
+			block b(1, "Block 1 Data");
+			block_stats stats;
+			uint64_t before = allocations.load();
+			b.mine_block(difficulty, *strategy, 0, vector<unsigned int>(), opts.affinity, &stats);
+			if (run >= 0)
+			{
+				counts[run] = allocations.load() - before;
+				attempts[run] = stats.attempts();
+			}
+		}
+		bool grew = counts[1] > counts[0];
+		cout << name << ": " << counts[0] << " allocations for " << attempts[0] << " attempts, "
+			<< counts[1] << " for " << attempts[1] << (grew ? " - FAILED" : "") << endl;
+		ok = ok && !grew;
+	}
+	counting_allocations.store(false);
+	return ok;
+}
+
+static void write_csv(const string &path, const bench_options &opts, const vector<bench_result> &results)
+{
+	ofstream out(path, ofstream::out);
+	out << "Strategy,Benchmark,Backend,Threads,Input Bytes,Difficulty,Reps,Median Seconds,P95 Seconds,Hashes Per Second,Affinity,Placement,Steals Per Block" << endl;
+	for (auto &r : results)
+	{
+		out << r.strategy << "," << r.name << "," << sha256_backend() << "," << r.threads << "," << r.input_bytes << ","
+			<< r.difficulty << "," << r.reps << "," << r.median_secs << "," << r.p95_secs << "," << r.hashes_per_sec << ","
+			<< (r.placement.empty() ? "none" : affinity_policy_name(opts.affinity)) << "," << r.placement << "," << r.steals_per_block << endl;
+	}
+}
+
+static void write_json(const string &path, const bench_options &opts, const vector<bench_result> &results)
+{
+	ofstream out(path, ofstream::out);
+	out << "{\n  \"sha256_backend\": \"" << sha256_backend() << "\",\n";
+	out << "  \"multi_buffer_engine\": \"" << sha256_multi_engine() << "\",\n";
+	out << "  \"affinity\": \"" << affinity_policy_name(opts.affinity) << "\",\n";
+	out << "  \"topology\": \"" << describe_topology() << "\",\n";
+	out << "  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		auto &r = results[i];
+		out << "    {\"benchmark\": \"" << r.name << "\", \"strategy\": \"" << r.strategy << "\", \"threads\": " << r.threads << ", \"input_bytes\": " << r.input_bytes
+			<< ", \"difficulty\": " << r.difficulty << ", \"reps\": " << r.reps << ", \"median_seconds\": " << r.median_secs
+			<< ", \"p95_seconds\": " << r.p95_secs << ", \"hashes_per_second\": " << r.hashes_per_sec << ", \"placement\": \"" << r.placement << "\", \"steals_per_block\": " << r.steals_per_block << "}"
+			<< (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+}
+
+int main(int argc, char **argv)
+{
+	bench_options opts;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg(argv[i]);
+		if (arg == "--check-allocations")
+			opts.check_allocations = true;
+		else if (i + 1 == argc)
+			break;
+		else if (arg == "--reps")
+			opts.reps = max<size_t>(1, stoul(argv[++i]));
+		else if (arg == "--warmup")
+			opts.warmup = stoul(argv[++i]);
+		else if (arg == "--difficulty")
+			opts.difficulty = static_cast<uint32_t>(stoul(argv[++i]));
+		else if (arg == "--blocks")
+			opts.blocks = static_cast<uint32_t>(stoul(argv[++i]));
+		else if (arg == "--strategy")
+			opts.strategy = argv[++i];
+		else if (arg == "--affinity")
+		{
+			if (!parse_affinity_policy(argv[++i], opts.affinity))
+			{
+				cout << "Unknown affinity policy " << argv[i] << endl;
+				return 1;
+			}
+		}
+		else if (arg == "--json")
+			opts.json = argv[++i];
+		else if (arg == "--trace")
+			trace_to_file(argv[++i]);
+	}
+
+	cout << "SHA-256 backend: " << sha256_backend() << ", multi-buffer engine: " << sha256_multi_engine() << endl;
+	cout << "Topology: " << describe_topology() << ", affinity: " << affinity_policy_name(opts.affinity) << endl;
+
+	vector<string> strategies = strategy_names();
+	if (!opts.strategy.empty())
+	{
+		if (!make_strategy(opts.strategy))
+		{
+			cout << "Unknown strategy " << opts.strategy << endl;
+			return 1;
+		}
+		strategies.assign(1, opts.strategy);
+	}
+
+	if (opts.check_allocations)
+	{
+		return check_allocations(opts, strategies) ? 0 : 1;
+	}
+
+	vector<bench_result> results;
+	for (size_t bytes : { 64, 256, 1024, 4096 })
+	{
+		results.push_back(bench_sha256(opts, bytes));
+	}
+
+	// Tree construction for a large block, across thread counts.
+	unsigned int max_threads = max(1u, thread::hardware_concurrency());
+	for (unsigned int threads = 1; ; threads *= 2)
+	{
+		unsigned int n = min(threads, max_threads);
+		results.push_back(bench_merkle(opts, 1u << 16, 256, n));
+		if (n == max_threads)
+			break;
+	}
+
+	// Powers of two up to the processor count, plus the count itself.
+	// The serial strategy only ever uses one.
+	for (auto &name : strategies)
+	{
+		for (unsigned int threads = 1; ; threads *= 2)
+		{
+			unsigned int n = min(threads, max_threads);
+			results.push_back(bench_mine(opts, name, n));
+			if (n == max_threads || name == "serial")
+				break;
+		}
+	}
+
+	write_csv("Benchmark.csv", opts, results);
+	if (!opts.json.empty())
+	{
+		write_json(opts.json, opts, results);
+	}
+
+	return 0;
+}
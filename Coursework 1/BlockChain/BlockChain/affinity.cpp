@@ -0,0 +1,251 @@
+#include "affinity.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+bool pin_current_thread(const vector<unsigned int> &cpus) noexcept
+{
+	if (cpus.empty())
+	{
+		return true;
+	}
+#if defined(_WIN32)
+	DWORD_PTR mask = 0;
+	for (auto cpu : cpus)
+	{
+		if (cpu < sizeof(DWORD_PTR) * 8)
+			mask |= static_cast<DWORD_PTR>(1) << cpu;
+	}
+	return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (auto cpu : cpus)
+	{
+		if (cpu < CPU_SETSIZE)
+			CPU_SET(cpu, &set);
+	}
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+vector<unsigned int> cpu_subset(unsigned int index, unsigned int count)
+{
+	unsigned int num_cpus = thread::hardware_concurrency();
+	if (num_cpus == 0)
+	{
+		num_cpus = 1;
+	}
+	if (count == 0)
+	{
+		count = 1;
+	}
+
+	unsigned int per_group = num_cpus / count;
+	if (per_group == 0)
+	{
+		per_group = 1;
+	}
+
+	vector<unsigned int> cpus;
+	for (unsigned int i = 0; i < per_group; ++i)
+	{
+		cpus.push_back((index * per_group + i) % num_cpus);
+	}
+	return cpus;
+}
+
+namespace
+{
+	// Reads a single number from a sysfs file.
+	bool read_number(const string &path, unsigned int &value)
+	{
+		ifstream file(path);
+		return static_cast<bool>(file >> value);
+	}
+
+	// Parses a CPU list such as "0-3,8,10-11".
+	vector<unsigned int> parse_cpu_list(const string &list)
+	{
+		vector<unsigned int> cpus;
+		stringstream ss(list);
+		string range;
+		while (getline(ss, range, ','))
+		{
+			size_t dash = range.find('-');
+			try
+			{
+				unsigned int first = static_cast<unsigned int>(stoul(range.substr(0, dash)));
+				unsigned int last = dash == string::npos ? first : static_cast<unsigned int>(stoul(range.substr(dash + 1)));
+				for (unsigned int cpu = first; cpu <= last; ++cpu)
+					cpus.push_back(cpu);
+			}
+			catch (const exception &)
+			{
+				return vector<unsigned int>();
+			}
+		}
+		return cpus;
+	}
+
+	vector<cpu_location> flat_topology()
+	{
+		unsigned int num_cpus = max(1u, thread::hardware_concurrency());
+		vector<cpu_location> cpus;
+		for (unsigned int cpu = 0; cpu < num_cpus; ++cpu)
+		{
+			cpu_location c = { cpu, 0, cpu, 0 };
+			cpus.push_back(c);
+		}
+		return cpus;
+	}
+}
+
+vector<cpu_location> cpu_topology(const string &root)
+{
+#if defined(__linux__)
+	string online;
+	{
+		ifstream file(root + "/online");
+		getline(file, online);
+	}
+	vector<unsigned int> ids = parse_cpu_list(online);
+	if (ids.empty())
+	{
+		return flat_topology();
+	}
+
+	// Raw package and core ids, which needn't be contiguous.
+	vector<cpu_location> cpus;
+	for (auto id : ids)
+	{
+		string dir = root + "/cpu" + to_string(id) + "/topology/";
+		cpu_location c = { id, 0, 0, 0 };
+		if (!read_number(dir + "physical_package_id", c.package) || !read_number(dir + "core_id", c.core))
+		{
+			return flat_topology();
+		}
+		cpus.push_back(c);
+	}
+
+	// Number the cores within each package, and the siblings within each core.
+	map<pair<unsigned int, unsigned int>, vector<size_t>> cores;
+	for (size_t i = 0; i < cpus.size(); ++i)
+	{
+		cores[make_pair(cpus[i].package, cpus[i].core)].push_back(i);
+	}
+	map<unsigned int, unsigned int> next_core;
+	for (auto &core : cores)
+	{
+		unsigned int rank = next_core[core.first.first]++;
+		unsigned int sibling = 0;
+		for (auto i : core.second)
+		{
+			cpus[i].core = rank;
+			cpus[i].thread = sibling++;
+		}
+	}
+	return cpus;
+#else
+	(void)root;
+	return flat_topology();
+#endif
+}
+
+const vector<cpu_location>& machine_topology()
+{
+	static const vector<cpu_location> topology = cpu_topology();
+	return topology;
+}
+
+bool parse_affinity_policy(const string &name, affinity_policy &policy) noexcept
+{
+	if (name == "none")
+		policy = affinity_policy::none;
+	else if (name == "compact")
+		policy = affinity_policy::compact;
+	else if (name == "scatter")
+		policy = affinity_policy::scatter;
+	else if (name == "physical")
+		policy = affinity_policy::physical;
+	else
+		return false;
+	return true;
+}
+
+const char *affinity_policy_name(affinity_policy policy) noexcept
+{
+	switch (policy)
+	{
+	case affinity_policy::compact:
+		return "compact";
+	case affinity_policy::scatter:
+		return "scatter";
+	case affinity_policy::physical:
+		return "physical";
+	default:
+		return "none";
+	}
+}
+
+vector<unsigned int> place_workers(affinity_policy policy, unsigned int num_workers, const vector<unsigned int> &cpus, const vector<cpu_location> &topology)
+{
+	if (policy == affinity_policy::none)
+	{
+		return vector<unsigned int>();
+	}
+
+	vector<cpu_location> order;
+	for (auto &c : topology)
+	{
+		if (cpus.empty() || find(cpus.begin(), cpus.end(), c.cpu) != cpus.end())
+			order.push_back(c);
+	}
+	if (policy == affinity_policy::physical)
+	{
+		// A set of nothing but SMT siblings still gets used.
+		auto cores_end = remove_if(order.begin(), order.end(), [](const cpu_location &c) { return c.thread != 0; });
+		if (cores_end != order.begin())
+			order.erase(cores_end, order.end());
+	}
+	if (order.empty())
+	{
+		return vector<unsigned int>();
+	}
+	if (policy == affinity_policy::scatter)
+	{
+		sort(order.begin(), order.end(), [](const cpu_location &a, const cpu_location &b)
+		{
+			return make_tuple(a.thread, a.core, a.package) < make_tuple(b.thread, b.core, b.package);
+		});
+	}
+	else
+	{
+		sort(order.begin(), order.end(), [](const cpu_location &a, const cpu_location &b)
+		{
+			return make_tuple(a.package, a.core, a.thread) < make_tuple(b.package, b.core, b.thread);
+		});
+	}
+
+	vector<unsigned int> placement;
+	for (unsigned int w = 0; w < num_workers; ++w)
+	{
+		placement.push_back(order[w % order.size()].cpu);
+	}
+	return placement;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Restricts the calling thread to the given logical CPUs.  An empty
+// list leaves it free to run anywhere.  Returns false if the platform
+// refused or doesn't support pinning; mining still works, just unpinned.
+bool pin_current_thread(const std::vector<unsigned int> &cpus) noexcept;
+
+// Splits the machine's logical CPUs into count contiguous, equally
+// sized groups and returns group index.  When there are more groups
+// than CPUs the groups wrap around and share.
+std::vector<unsigned int> cpu_subset(unsigned int index, unsigned int count);
+
+// Where a logical CPU sits in the machine.
+struct cpu_location
+{
+	unsigned int cpu;
+	// Socket.
+	unsigned int package;
+	// Physical core, numbered from 0 within its package.
+	unsigned int core;
+	// Which of the core's SMT siblings this is, from 0.
+	unsigned int thread;
+};
+
+// The online logical CPUs, read from the topology under root on Linux.
+// Anywhere else, or if it can't be read, each CPU counts as a core of
+// its own in a single package.
+std::vector<cpu_location> cpu_topology(const std::string &root = "/sys/devices/system/cpu");
+// This machine's topology, read once and kept.
+const std::vector<cpu_location>& machine_topology();
+
+// How workers are spread over the machine.
+enum class affinity_policy
+{
+	// Not pinned; the OS moves them as it likes.
+	none,
+	// Packed in: SMT siblings, then cores, then packages.
+	compact,
+	// Spread out: across packages, then cores, sharing a core last.
+	scatter,
+	// One per physical core, leaving SMT siblings idle.
+	physical
+};
+
+// Accepts "none", "compact", "scatter" or "physical".
+bool parse_affinity_policy(const std::string &name, affinity_policy &policy) noexcept;
+const char *affinity_policy_name(affinity_policy policy) noexcept;
+
+// The logical CPU for each of num_workers workers, in worker order,
+// wrapping round if there are more workers than places.  Only CPUs in
+// cpus are used, unless it is empty.  Empty for affinity_policy::none.
+std::vector<unsigned int> place_workers(affinity_policy policy, unsigned int num_workers, const std::vector<unsigned int> &cpus = std::vector<unsigned int>(),
+	const std::vector<cpu_location> &topology = machine_topology());
@@ -0,0 +1,571 @@
+#include "block_chain.h"
+#include "sha256.h"
+#include "sha256_multi.h"
+#include "merkle.h"
+#include "mining_checkpoint.h"
+#include "trace.h"
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdio>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <omp.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace
+{
+	// What validation needs from a block, however the chain stores it.
+	struct block_fields
+	{
+		uint32_t index;
+		int64_t time;
+		const char *data;
+		size_t data_length;
+		uint64_t nonce;
+		bool nonce_last;
+		bool has_hash;
+		bool has_prev_hash;
+		// False if the block's transactions don't match its Merkle root.
+		bool payload_valid;
+		unsigned char hash[SHA256::DIGEST_SIZE];
+		unsigned char prev_hash[SHA256::DIGEST_SIZE];
+	};
+
+	// to_string without the temporary.
+	void append_decimal(string &out, int64_t value)
+	{
+		uint64_t magnitude = static_cast<uint64_t>(value);
+		if (value < 0)
+		{
+			out.push_back('-');
+			magnitude = 0 - magnitude;
+		}
+		char digits[20];
+		size_t n = 0;
+		do
+		{
+			digits[n++] = static_cast<char>('0' + magnitude % 10);
+			magnitude /= 10;
+		} while (magnitude != 0);
+		while (n > 0)
+		{
+			out.push_back(digits[--n]);
+		}
+	}
+
+	// Lays the header out exactly as mine_block hashes it: header_prefix,
+	// then the nonce, then the job's suffix.
+	// out keeps its capacity, so after the first few blocks this doesn't allocate.
+	void format_header(const block_fields &b, string &out)
+	{
+		char prev[2 * SHA256::DIGEST_SIZE];
+		size_t prev_length = 0;
+		if (b.has_prev_hash)
+		{
+			sha256_hex(b.prev_hash, prev);
+			prev_length = sizeof(prev);
+		}
+
+		out.clear();
+		append_decimal(out, b.index);
+		append_decimal(out, b.time);
+		out.append(b.data, b.data_length);
+		if (b.nonce_last)
+			out.append(prev, prev_length);
+		append_decimal(out, static_cast<int64_t>(b.nonce));
+		if (!b.nonce_last)
+			out.append(prev, prev_length);
+	}
+
+	// Checks blocks [begin, end), hashing SHA256_LANES headers per call to
+	// the multi-buffer engine.  Returns the first bad position, or end.
+	template <typename Fields>
+	size_t check_range(size_t begin, size_t end, const Fields &get_fields)
+	{
+		SHA256 initial;
+		initial.init();
+		block_fields fields[SHA256_LANES];
+		string headers[SHA256_LANES];
+		const unsigned char *tails[SHA256_LANES];
+		size_t lengths[SHA256_LANES];
+		unsigned char digests[SHA256_LANES][SHA256::DIGEST_SIZE];
+
+		// The block just before the range, so its first link can be checked.
+		block_fields previous;
+		if (begin > 0)
+		{
+			get_fields(begin - 1, previous);
+		}
+
+		for (size_t first = begin; first < end; first += SHA256_LANES)
+		{
+			size_t count = min(SHA256_LANES, end - first);
+			for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+			{
+				// Spare lanes at the end of a range just rehash the first.
+				size_t source = lane < count ? lane : 0;
+				if (lane < count)
+				{
+					get_fields(first + lane, fields[lane]);
+					format_header(fields[lane], headers[lane]);
+				}
+				tails[lane] = reinterpret_cast<const unsigned char*>(headers[source].data());
+				lengths[lane] = headers[source].length();
+			}
+			sha256_multi(initial, tails, lengths, digests);
+
+			for (size_t lane = 0; lane < count; ++lane)
+			{
+				size_t position = first + lane;
+				const block_fields &b = fields[lane];
+				const block_fields *prev = lane > 0 ? &fields[lane - 1] : (position > 0 ? &previous : nullptr);
+
+				if (!b.payload_valid)
+					return position;
+				// Only the genesis block is left unmined.
+				if (!b.has_hash ? position != 0 : memcmp(digests[lane], b.hash, SHA256::DIGEST_SIZE) != 0)
+					return position;
+				// Each block must point at the hash of the one before it.
+				if (prev == nullptr ? b.has_prev_hash : b.has_prev_hash != prev->has_hash)
+					return position;
+				if (b.has_prev_hash && memcmp(b.prev_hash, prev->hash, SHA256::DIGEST_SIZE) != 0)
+					return position;
+			}
+			previous = fields[count - 1];
+		}
+		return end;
+	}
+
+	// Splits positions [0, count) into ranges shared out between threads.
+	template <typename Fields>
+	size_t first_invalid(size_t count, const Fields &get_fields, unsigned int num_threads)
+	{
+		// Small enough to balance across threads, and for a bad block
+		// to stop ranges after it being checked at all.
+		const size_t RANGE = 4096;
+		const int num_ranges = static_cast<int>((count + RANGE - 1) / RANGE);
+		const int threads = num_threads == 0 ? omp_get_max_threads() : static_cast<int>(num_threads);
+		atomic<size_t> first(count);
+
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+		for (int r = 0; r < num_ranges; ++r)
+		{
+			size_t begin = static_cast<size_t>(r) * RANGE;
+			// Nothing after a known bad block can change the answer.
+			if (begin >= first.load(memory_order_relaxed))
+				continue;
+			size_t end = min(count, begin + RANGE);
+			size_t bad = check_range(begin, end, get_fields);
+			if (bad == end)
+				continue;
+			size_t current = first.load();
+			while (bad < current && !first.compare_exchange_weak(current, bad))
+			{
+			}
+		}
+		return first.load();
+	}
+}
+
+// Note that _time would normally be set to the time of the block's creation.
+// This is part of the audit a block chain.  To enable consistent results
+// from parallelisation we will just use the index value, so time increments
+// by one each time: 1, 2, 3, etc.
+block::block(uint32_t index, const string &data)
+	: _index(index), _data(data), _nonce(0), _time(static_cast<long>(index))
+{
+}
+
+block::block(uint32_t index, const vector<string> &transactions, unsigned int num_threads)
+	: _index(index), _nonce(0), _transactions(transactions), _time(static_cast<long>(index))
+{
+	sha256_digest root = merkle_root(_transactions, num_threads);
+	_data.assign(reinterpret_cast<const char*>(root.data()), root.size());
+}
+
+block::block(const block_record &record)
+	: _index(record.index), _nonce(record.nonce), _data(record.data(), record.data_length), _time(static_cast<long>(record.time))
+{
+	// Only prev_hash goes back into the header as hex.
+	if (record.flags & block_record::HAS_HASH)
+	{
+		memcpy(_hash.data(), record.hash, SHA256::DIGEST_SIZE);
+		_has_hash = true;
+	}
+	if (record.flags & block_record::HAS_PREV_HASH)
+		prev_hash = sha256_hex(record.prev_hash);
+	nonce_last = (record.flags & block_record::NONCE_LAST) != 0;
+}
+
+bool block::mine_block(uint32_t difficulty, mining_strategy &strategy, unsigned int num_threads, const vector<unsigned int> &cpus,
+	affinity_policy affinity, block_stats *stats, const atomic<bool> *cancel, checkpoint_saver *checkpoint) noexcept
+{
+	trace_scope scope("mine_block");
+	// Absorb everything ahead of the nonce once up front.  With the
+	// nonce last each attempt then only compresses the final block or two.
+	mining_job job;
+	job.midstate.init();
+	string prefix = header_prefix();
+	job.midstate.update(reinterpret_cast<const unsigned char*>(prefix.c_str()), prefix.length());
+	job.suffix = nonce_last ? string() : prev_hash;
+	job.difficulty = difficulty;
+	job.num_threads = num_threads;
+	job.cpus = cpus;
+	// Enough places for whichever is more: the threads asked for, or a
+	// pool sized to the machine.
+	job.worker_cpus = place_workers(affinity, max(num_threads, thread::hardware_concurrency()), cpus);
+	job.cancel = cancel;
+
+	// A checkpoint left by some other block's search is kept for that
+	// block, and this one goes without.
+	mining_checkpoint identity;
+	identity.prefix = prefix;
+	identity.suffix = job.suffix;
+	identity.difficulty = difficulty;
+	identity.nonce_spacing = job.nonce_spacing;
+	const bool checkpointing = checkpoint != nullptr && strategy.resumable() && checkpoint->claim(identity, job.first_nonce);
+	if (checkpointing && job.first_nonce != 1)
+	{
+		stringstream line;
+		line << "Block " << _index << " resumed from nonce " << job.first_nonce << endl;
+		cout << line.str() << flush;
+	}
+
+	mining_outcome outcome;
+
+	// Progress is saved from the saver's own thread, so all the search
+	// threads ever do for it is note their next nonce now and then.
+	if (checkpointing)
+	{
+		checkpoint->watch(job, outcome);
+	}
+
+	auto start = steady_clock::now();
+
+	strategy.mine(job, outcome);
+
+	if (checkpointing)
+	{
+		checkpoint->finish();
+	}
+
+	if (!outcome.found.load())
+	{
+		stringstream line;
+		line << "Block " << _index << " abandoned" << endl;
+		cout << line.str() << flush;
+		return false;
+	}
+
+	_nonce = outcome.nonce;
+	_hash = outcome.digest;
+	_has_hash = true;
+
+	auto end = steady_clock::now();
+	duration<double> diff = end - start;
+	if (stats != nullptr)
+	{
+		// Strategies that publish some other way leave solved unset.
+		auto solved = outcome.solved == steady_clock::time_point() ? end : outcome.solved;
+		*stats = summarise(outcome, _index, difficulty, diff.count(), duration<double>(solved - start).count());
+	}
+	// Build the line first, so chains mined side by side
+	// don't interleave their output.
+	stringstream line;
+	line << "Block " << _index << " mined: " << get_hash() << " in " << diff.count() << " seconds" << endl;
+	cout << line.str() << flush;
+	return true;
+}
+
+std::string block::header_prefix() const noexcept
+{
+	string ss;
+	ss.append(to_string(_index));
+	ss.append(to_string(_time));
+	ss.append(_data);
+	// In the original layout the nonce comes before prev_hash.
+	if (nonce_last)
+	{
+		ss.append(prev_hash);
+	}
+	return ss;
+}
+
+block_chain::block_chain()
+	: block_chain(make_strategy("openmp"))
+{
+}
+
+block_chain::block_chain(unique_ptr<mining_strategy> strategy)
+	: _strategy(move(strategy))
+{
+	// Instead of declaring difficulty here,
+	_chain.append(block(0, "Genesis Block"));
+}
+
+block_chain::~block_chain()
+{
+	{
+		lock_guard<mutex> lock(_pending_mutex);
+		_stop = true;
+		_current.cancel();
+		for (auto &p : _pending)
+			p.token.cancel();
+	}
+	_pending_ready.notify_all();
+	if (_miner.joinable())
+	{
+		_miner.join();
+	}
+}
+
+bool block_chain::mine_and_append(block &&new_block, uint32_t difficulty, const atomic<bool> *cancel, block_ref *ref) noexcept
+{
+	// Let main pass it as a parameter for easier serialisation.
+	size_t last = _chain.size() - 1;
+	new_block.prev_hash = _chain.has_hash(last) ? sha256_hex(_chain.hash(last).data()) : string();
+	new_block.nonce_last = nonce_last;
+	// The saver's thread is kept from block to block, and only replaced
+	// if the file or period is changed.
+	if (checkpoint_path.empty())
+	{
+		_saver.reset();
+	}
+	else if (!_saver || _saver->path() != checkpoint_path || _saver->seconds() != checkpoint_seconds)
+	{
+		_saver.reset(new checkpoint_saver(checkpoint_path, checkpoint_seconds));
+	}
+	block_stats mined;
+	if (!new_block.mine_block(difficulty, *_strategy, num_threads, cpus, affinity, &mined, cancel, _saver.get()))
+	{
+		return false;
+	}
+	_stats.add(move(mined));
+	size_t position = size();
+	// A block the file doesn't have can't be looked up by its position.
+	if (_file.is_open() && !_file.append(new_block))
+	{
+		cerr << "Failed to append block " << new_block.get_index() << " to the chain file" << endl;
+		return false;
+	}
+	if (ref != nullptr)
+	{
+		ref->added = true;
+		ref->position = position;
+		ref->index = new_block.get_index();
+		ref->nonce = new_block.get_nonce();
+		ref->hash = new_block.get_digest();
+	}
+	_by_hash.insert(new_block.get_digest().data(), position);
+	_chain.append(move(new_block));
+	return true;
+}
+
+void block_chain::add_block(block &&new_block, uint32_t difficulty) noexcept
+{
+	trace_scope scope("add_block");
+	wait();
+	mine_and_append(move(new_block), difficulty, nullptr, nullptr);
+}
+
+future<block_ref> block_chain::add_block_async(block &&new_block, uint32_t difficulty, cancel_token token)
+{
+	pending_block p = { move(new_block), difficulty, token, promise<block_ref>() };
+	future<block_ref> result = p.result.get_future();
+	{
+		lock_guard<mutex> lock(_pending_mutex);
+		_pending.push_back(move(p));
+		if (!_miner.joinable())
+		{
+			_miner = thread(&block_chain::miner_loop, this);
+		}
+	}
+	_pending_ready.notify_one();
+	return result;
+}
+
+void block_chain::wait()
+{
+	unique_lock<mutex> lock(_pending_mutex);
+	_pending_done.wait(lock, [this] { return _pending.empty() && !_busy; });
+}
+
+void block_chain::miner_loop()
+{
+	trace_thread_name("chain miner");
+	unique_lock<mutex> lock(_pending_mutex);
+	while (true)
+	{
+		_pending_ready.wait(lock, [this] { return _stop || !_pending.empty(); });
+		// Shutdown still works through the queue, so every future is
+		// answered; the blocks in it have all been cancelled.
+		if (_pending.empty())
+		{
+			return;
+		}
+		pending_block next = move(_pending.front());
+		_pending.pop_front();
+		_current = next.token;
+		_busy = true;
+		lock.unlock();
+
+		block_ref ref;
+		if (!next.token.cancelled())
+		{
+			trace_scope scope("add_block_async");
+			mine_and_append(move(next.b), next.difficulty, next.token.flag(), &ref);
+		}
+		next.result.set_value(ref);
+
+		lock.lock();
+		_busy = false;
+		if (_pending.empty())
+		{
+			_pending_done.notify_all();
+		}
+	}
+}
+
+bool block_chain::open(const string &path)
+{
+	if (!_file.open(path))
+	{
+		return false;
+	}
+
+	// A fresh file starts with whatever has been mined in memory.
+	if (_file.size() == 0)
+	{
+		for (size_t i = 0; i < _chain.size(); ++i)
+		{
+			if (!_file.append(_chain.get(i)))
+			{
+				_file.close();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Otherwise only the last block is needed to keep mining; the
+	// rest stay in the mapping rather than being copied out.
+	_chain.clear();
+	_chain.append(block(_file.back()));
+	// The index covers the whole file, so it's rebuilt from the mapping.
+	_by_hash.rebuild(_file.size(), [this](size_t i) { return hash_at(i); }, omp_get_max_threads());
+	return true;
+}
+
+const unsigned char* block_chain::hash_at(size_t position) const noexcept
+{
+	// A chain on file has every block in the mapping.
+	if (_file.is_open())
+	{
+		const block_record &r = _file[position];
+		return (r.flags & block_record::HAS_HASH) ? r.hash : nullptr;
+	}
+	return _chain.has_hash(position) ? _chain.hash(position).data() : nullptr;
+}
+
+bool block_chain::find(const sha256_digest &hash, size_t &position) const noexcept
+{
+	uint64_t found;
+	if (!_by_hash.find(hash.data(), [this](size_t i) { return hash_at(i); }, found))
+	{
+		return false;
+	}
+	position = static_cast<size_t>(found);
+	return true;
+}
+
+block_ref block_chain::at(size_t position) const noexcept
+{
+	block_ref ref;
+	ref.added = true;
+	ref.position = position;
+	if (_file.is_open())
+	{
+		const block_record &r = _file[position];
+		ref.index = r.index;
+		ref.nonce = r.nonce;
+		if (r.flags & block_record::HAS_HASH)
+			memcpy(ref.hash.data(), r.hash, SHA256::DIGEST_SIZE);
+	}
+	else
+	{
+		ref.index = _chain.index(position);
+		ref.nonce = _chain.nonce(position);
+		if (_chain.has_hash(position))
+			ref.hash = _chain.hash(position);
+	}
+	return ref;
+}
+
+size_t block_chain::validate(unsigned int num_threads) const
+{
+	// A chain on file is read straight out of the mapping.
+	if (_file.is_open())
+	{
+		return first_invalid(_file.size(), [this](size_t i, block_fields &f)
+		{
+			const block_record &r = _file[i];
+			f.index = r.index;
+			f.time = r.time;
+			f.data = r.data();
+			f.data_length = r.data_length;
+			f.nonce = r.nonce;
+			f.nonce_last = (r.flags & block_record::NONCE_LAST) != 0;
+			f.has_hash = (r.flags & block_record::HAS_HASH) != 0;
+			f.has_prev_hash = (r.flags & block_record::HAS_PREV_HASH) != 0;
+			// Only the Merkle root is kept on file.
+			f.payload_valid = true;
+			memcpy(f.hash, r.hash, SHA256::DIGEST_SIZE);
+			memcpy(f.prev_hash, r.prev_hash, SHA256::DIGEST_SIZE);
+		}, num_threads);
+	}
+
+	return first_invalid(_chain.size(), [this](size_t i, block_fields &f)
+	{
+		f.index = _chain.index(i);
+		f.time = _chain.time(i);
+		f.data = _chain.data(i);
+		f.data_length = _chain.data_length(i);
+		f.nonce = _chain.nonce(i);
+		f.nonce_last = _chain.nonce_last(i);
+		f.has_hash = _chain.has_hash(i);
+		if (f.has_hash)
+			memcpy(f.hash, _chain.hash(i).data(), SHA256::DIGEST_SIZE);
+		// Links are implied by the layout, so the header is rebuilt
+		// from the stored hash before it and any edit shows as a bad hash.
+		f.has_prev_hash = i > 0 && _chain.has_hash(i - 1);
+		if (f.has_prev_hash)
+			memcpy(f.prev_hash, _chain.hash(i - 1).data(), SHA256::DIGEST_SIZE);
+		// Validation already has every thread busy, so the tree is rebuilt on this one.
+		size_t count = _chain.transaction_count(i);
+		if (count == 0)
+		{
+			f.payload_valid = true;
+		}
+		else
+		{
+			vector<const unsigned char*> transactions(count);
+			vector<size_t> lengths(count);
+			for (size_t t = 0; t < count; ++t)
+			{
+				transactions[t] = reinterpret_cast<const unsigned char*>(_chain.transaction(i, t));
+				lengths[t] = _chain.transaction_length(i, t);
+			}
+			sha256_digest root = merkle_root(transactions.data(), lengths.data(), count, 1);
+			f.payload_valid = f.data_length == root.size() && memcmp(f.data, root.data(), root.size()) == 0;
+		}
+	}, num_threads);
+}
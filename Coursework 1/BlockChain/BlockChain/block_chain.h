@@ -0,0 +1,233 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <memory>
+#include <atomic>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "mining_strategy.h"
+#include "affinity.h"
+#include "chain_file.h"
+#include "chain_store.h"
+#include "mining_stats.h"
+#include "hash_index.h"
+#include "mining_checkpoint.h"
+
+class block
+{
+private:
+    // The index of the block in the chain.
+    uint32_t _index;
+    // A modifier used to get a suitable block.
+    uint64_t _nonce;
+    // Data stored in the block.  For a block of transactions this is
+    // just their 32 byte Merkle root, so only the root is hashed.
+    std::string _data;
+    // The transactions summarised by _data, if the block has any.
+    std::vector<std::string> _transactions;
+    // Hash code of this block, once it has been mined.
+    sha256_digest _hash = sha256_digest();
+    bool _has_hash = false;
+    // Time code block was created.
+    long _time;
+
+    // Every header field that comes before the nonce.
+    std::string header_prefix() const noexcept;
+
+    friend class chain_store;
+
+public:
+    block(uint32_t index, const std::string &data);
+    // A block carrying transactions.  Their Merkle root is built up
+    // front with num_threads threads (0 for one per hardware thread).
+    block(uint32_t index, const std::vector<std::string> &transactions, unsigned int num_threads = 0);
+    // Rebuilds a block from its record in a chain file.
+    explicit block(const block_record &record);
+
+    // Blocks are handed on, never duplicated.
+    block(block &&) = default;
+    block& operator=(block &&) = default;
+    block(const block &) = delete;
+    block& operator=(const block &) = delete;
+
+    // Difficulty is the minimum number of zeros we require at the
+    // start of the hash.  The strategy decides how the nonces are
+    // searched, using num_threads threads (0 for one per hardware
+    // thread), each pinned to cpus if it isn't empty.  An affinity
+    // policy other than none instead pins each thread to a CPU of its
+    // own, chosen from cpus (or the whole machine).  How the search
+    // went is written to stats, if given.  Setting cancel abandons the
+    // search; returns false if it was, leaving the block unmined.  With
+    // a checkpoint saver, the search's progress is saved every few
+    // seconds, and a search for this same block is resumed from its
+    // file rather than started again.
+    bool mine_block(uint32_t difficulty, mining_strategy &strategy, unsigned int num_threads = 0, const std::vector<unsigned int> &cpus = std::vector<unsigned int>(),
+        affinity_policy affinity = affinity_policy::none, block_stats *stats = nullptr, const std::atomic<bool> *cancel = nullptr, checkpoint_saver *checkpoint = nullptr) noexcept;
+
+    // The hash in hex, or empty if the block hasn't been mined.
+    inline std::string get_hash() const { return _has_hash ? sha256_hex(_hash.data()) : std::string(); }
+    inline const sha256_digest& get_digest() const noexcept { return _hash; }
+    inline bool has_hash() const noexcept { return _has_hash; }
+    inline uint64_t get_nonce() const noexcept { return _nonce; }
+    inline uint32_t get_index() const noexcept { return _index; }
+    inline long get_time() const noexcept { return _time; }
+    inline const std::string& get_data() const noexcept { return _data; }
+    inline const std::vector<std::string>& get_transactions() const noexcept { return _transactions; }
+
+    // Hash code of the previous block in the chain.
+    std::string prev_hash;
+
+    // Serialise the nonce after prev_hash rather than before it.
+    // Everything ahead of the nonce is then constant while mining,
+    // so it can be hashed once and resumed from for each attempt.
+    bool nonce_last = false;
+};
+
+// Lets the caller of add_block_async abandon a block, whether it is
+// still queued or already being mined.  Copies share the same flag.
+class cancel_token
+{
+private:
+    std::shared_ptr<std::atomic<bool>> _cancelled;
+
+public:
+    cancel_token() : _cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+    inline void cancel() noexcept { _cancelled->store(true); }
+    inline bool cancelled() const noexcept { return _cancelled->load(); }
+    inline const std::atomic<bool>* flag() const noexcept { return _cancelled.get(); }
+};
+
+// Where a block added with add_block_async ended up.
+struct block_ref
+{
+    // False if the block was cancelled before it was mined.
+    bool added = false;
+    // Its position in the chain.
+    size_t position = 0;
+    uint32_t index = 0;
+    uint64_t nonce = 0;
+    sha256_digest hash = sha256_digest();
+};
+
+class block_chain
+{
+private:
+    // Mined blocks, kept as fixed-size fields plus a data arena.
+    chain_store _chain;
+    // How this chain's blocks are mined.  Strategies such as the pool
+    // own long-lived threads, so it lives as long as the chain.
+    std::unique_ptr<mining_strategy> _strategy;
+    // Where blocks are persisted, if the chain has been opened on a file.
+    chain_file _file;
+    // How each block added since the chain was created was mined.
+    chain_stats _stats;
+    // Every mined block's position, by hash.
+    hash_index _by_hash;
+    // Saves searches to checkpoint_path, once that has been set.
+    std::unique_ptr<checkpoint_saver> _saver;
+
+    // The raw hash of the block at position, or nullptr if it has none.
+    const unsigned char* hash_at(size_t position) const noexcept;
+
+    // A block waiting for the background miner.
+    struct pending_block
+    {
+        block b;
+        uint32_t difficulty;
+        cancel_token token;
+        std::promise<block_ref> result;
+    };
+    // Blocks from add_block_async, mined one at a time in the order
+    // they were added by a thread started on the first call.
+    std::deque<pending_block> _pending;
+    std::mutex _pending_mutex;
+    // Signalled when a block is queued, or on shutdown.
+    std::condition_variable _pending_ready;
+    // Signalled when the background miner runs out of blocks.
+    std::condition_variable _pending_done;
+    // The block the background miner is on, so shutdown can cancel it.
+    cancel_token _current;
+    bool _busy = false;
+    bool _stop = false;
+    std::thread _miner;
+
+    void miner_loop();
+    // Mines the block on top of the chain and appends it, unless cancel is set first
+    // or the chain file can't take it.
+    bool mine_and_append(block &&new_block, uint32_t difficulty, const std::atomic<bool> *cancel, block_ref *ref) noexcept;
+
+public:
+    // Mines with the "openmp" strategy unless told otherwise.
+    block_chain();
+    explicit block_chain(std::unique_ptr<mining_strategy> strategy);
+    // Cancels any blocks still waiting to be mined.
+    ~block_chain();
+
+    block_chain(const block_chain&) = delete;
+    block_chain& operator=(const block_chain&) = delete;
+
+    inline mining_strategy& get_strategy() noexcept { return *_strategy; }
+    inline void set_strategy(std::unique_ptr<mining_strategy> strategy) noexcept { _strategy = std::move(strategy); }
+
+    // Backs the chain with an append-only file.  If it already holds
+    // blocks, mining carries on from the last of them; otherwise the
+    // blocks so far are written out.  Every block added afterwards is
+    // appended as soon as it is mined.
+    bool open(const std::string &path);
+    // Blocks in the chain, counting any that were only loaded from file.
+    inline size_t size() const noexcept { return _file.is_open() ? _file.size() : _chain.size(); }
+
+    // Recomputes every block's hash and checks each one points at the
+    // hash of the block before it.  The chain is split into ranges
+    // checked by num_threads threads (0 for one per hardware thread).
+    // Returns the position of the first invalid block, or size() if
+    // the whole chain is valid.
+    size_t validate(unsigned int num_threads = 0) const;
+
+    // Looks a block up by its hash in constant time, wherever it is in
+    // the chain.  Returns false if no block has that hash.
+    bool find(const sha256_digest &hash, size_t &position) const noexcept;
+    // The block at a position in the chain, such as one from find.
+    block_ref at(size_t position) const noexcept;
+
+    // Per-thread counters for every block mined by this chain.  Blocks
+    // loaded from a chain file weren't mined here, so have none.
+    inline const chain_stats& stats() const noexcept { return _stats; }
+
+	// Results file for storing average block time and difficulty.
+	std::ofstream results;
+	// Opt-in nonce-last header layout for newly added blocks.
+	bool nonce_last = false;
+	// Threads used to mine each block; 0 means one per hardware thread.
+	// Chains mined side by side should each get a share of the machine.
+	unsigned int num_threads = 0;
+	// Logical CPUs this chain's mining threads are pinned to, if any.
+	std::vector<unsigned int> cpus;
+	// How the mining threads are placed on the CPUs.
+	affinity_policy affinity = affinity_policy::none;
+	// If set, each block's search is checkpointed to this file every
+	// checkpoint_seconds, so a restarted run resumes a long block.
+	std::string checkpoint_path;
+	unsigned int checkpoint_seconds = 10;
+	// Mines the block on top of the chain, on the calling thread.  Any
+	// blocks still queued by add_block_async go first.
+	void add_block(block &&new_block, uint32_t difficulty) noexcept;
+	// Queues the block to be mined on top of the chain in the background
+	// and returns straight away.  The future is ready once the block is
+	// in the chain, or has been abandoned through token or couldn't be
+	// written to the chain file.  A block left out this way doesn't stop
+	// the blocks queued after it; they are mined on top of whatever came
+	// before it.  Until wait() returns, the chain and
+	// the settings above belong to the background miner.
+	std::future<block_ref> add_block_async(block &&new_block, uint32_t difficulty, cancel_token token = cancel_token());
+	// Blocks until every queued block has been mined or abandoned.
+	void wait();
+};
\ No newline at end of file
@@ -0,0 +1,303 @@
+#include "chain_file.h"
+#include "block_chain.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+	// Every chain file starts with this, so a stray file isn't read as blocks.
+	struct file_header
+	{
+		char magic[4];
+		uint32_t version;
+	};
+
+	const file_header CHAIN_FILE_HEADER = { { 'B', 'C', 'H', 'N' }, 1 };
+
+	// Records are padded so every header lands on an 8 byte boundary.
+	inline uint64_t record_length(uint32_t data_length) noexcept
+	{
+		return (sizeof(block_record) + data_length + 7) & ~static_cast<uint64_t>(7);
+	}
+}
+
+chain_file::chain_file()
+	:
+#if defined(_WIN32)
+	_file(INVALID_HANDLE_VALUE), _mapping(nullptr),
+#else
+	_fd(-1),
+#endif
+	_view(nullptr), _length(0)
+{
+}
+
+chain_file::~chain_file()
+{
+	close();
+}
+
+bool chain_file::open(const string &path)
+{
+	close();
+
+	uint64_t file_size = 0;
+#if defined(_WIN32)
+	_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_file, &size))
+	{
+		close();
+		return false;
+	}
+	file_size = static_cast<uint64_t>(size.QuadPart);
+#else
+	_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (_fd < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	if (fstat(_fd, &st) != 0)
+	{
+		close();
+		return false;
+	}
+	file_size = static_cast<uint64_t>(st.st_size);
+#endif
+
+	// A new file just gets its header, as does one whose header never
+	// finished being written.  Anything else that short isn't ours.
+	if (file_size < sizeof(file_header))
+	{
+		if (file_size != 0)
+		{
+			_length = file_size;
+			bool torn_header = map() && memcmp(_view, &CHAIN_FILE_HEADER, static_cast<size_t>(file_size)) == 0;
+			unmap();
+			_length = 0;
+			if (!torn_header)
+			{
+				close();
+				return false;
+			}
+		}
+		if (!truncate(0) || !write_at(0, &CHAIN_FILE_HEADER, sizeof(file_header)))
+		{
+			close();
+			return false;
+		}
+		_length = sizeof(file_header);
+		return map();
+	}
+
+	_length = file_size;
+	if (!map() || memcmp(_view, &CHAIN_FILE_HEADER, sizeof(file_header)) != 0)
+	{
+		close();
+		return false;
+	}
+
+	// Walk the records once.  Sizing the offsets from the first record
+	// keeps this to a handful of allocations however long the chain is.
+	uint64_t offset = sizeof(file_header);
+	if (file_size >= offset + sizeof(block_record))
+	{
+		_offsets.reserve(static_cast<size_t>((file_size - offset) / record_length(reinterpret_cast<const block_record*>(_view + offset)->data_length)) + 1);
+	}
+	while (offset + sizeof(block_record) <= file_size)
+	{
+		const block_record &record = *reinterpret_cast<const block_record*>(_view + offset);
+		uint64_t length = record_length(record.data_length);
+		if (offset + length > file_size)
+		{
+			break;
+		}
+		_offsets.push_back(offset);
+		offset += length;
+	}
+
+	// Whatever is left over should be the last record, which never
+	// finished being written.  If there is room in it for another whole
+	// record, it may instead be a damaged length with good records
+	// behind it, so leave the file for someone to look at.
+	if (offset != file_size)
+	{
+		if (file_size - offset >= 2 * sizeof(block_record))
+		{
+			close();
+			return false;
+		}
+		unmap();
+		if (!truncate(offset))
+		{
+			close();
+			return false;
+		}
+		_length = offset;
+		return map();
+	}
+	return true;
+}
+
+void chain_file::close() noexcept
+{
+	unmap();
+#if defined(_WIN32)
+	if (_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(_file);
+		_file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (_fd >= 0)
+	{
+		::close(_fd);
+		_fd = -1;
+	}
+#endif
+	_length = 0;
+	_offsets.clear();
+}
+
+bool chain_file::append(const block &b)
+{
+	const string &data = b.get_data();
+	uint64_t length = record_length(static_cast<uint32_t>(data.length()));
+
+	// Build the whole record first so it goes out in a single write.
+	vector<unsigned char> bytes(static_cast<size_t>(length), 0);
+	block_record &record = *reinterpret_cast<block_record*>(bytes.data());
+	record.index = b.get_index();
+	record.nonce = b.get_nonce();
+	record.time = b.get_time();
+	record.data_length = static_cast<uint32_t>(data.length());
+	record.flags = b.nonce_last ? block_record::NONCE_LAST : 0;
+	if (b.has_hash())
+	{
+		memcpy(record.hash, b.get_digest().data(), SHA256::DIGEST_SIZE);
+		record.flags |= block_record::HAS_HASH;
+	}
+	if (sha256_from_hex(b.prev_hash, record.prev_hash))
+		record.flags |= block_record::HAS_PREV_HASH;
+	memcpy(bytes.data() + sizeof(block_record), data.data(), data.length());
+
+	// The mapping only covers the old length, so drop it, write
+	// past the end and map the file again at its new size.
+	unmap();
+	if (!write_at(_length, bytes.data(), bytes.size()))
+	{
+		if (!map())
+		{
+			close();
+		}
+		return false;
+	}
+	_offsets.push_back(_length);
+	_length += length;
+	// Without a mapping no record can be read, so don't stay open.
+	if (!map())
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool chain_file::map() noexcept
+{
+#if defined(_WIN32)
+	_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (_mapping == nullptr)
+	{
+		return false;
+	}
+	_view = static_cast<const unsigned char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+	return _view != nullptr;
+#else
+	void *view = mmap(nullptr, static_cast<size_t>(_length), PROT_READ, MAP_SHARED, _fd, 0);
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+	_view = static_cast<const unsigned char*>(view);
+	return true;
+#endif
+}
+
+void chain_file::unmap() noexcept
+{
+#if defined(_WIN32)
+	if (_view != nullptr)
+		UnmapViewOfFile(_view);
+	if (_mapping != nullptr)
+		CloseHandle(_mapping);
+	_mapping = nullptr;
+#else
+	if (_view != nullptr)
+		munmap(const_cast<unsigned char*>(_view), static_cast<size_t>(_length));
+#endif
+	_view = nullptr;
+}
+
+bool chain_file::write_at(uint64_t offset, const void *bytes, size_t length) noexcept
+{
+	const char *next = static_cast<const char*>(bytes);
+#if defined(_WIN32)
+	LARGE_INTEGER position;
+	position.QuadPart = static_cast<LONGLONG>(offset);
+	if (!SetFilePointerEx(_file, position, nullptr, FILE_BEGIN))
+	{
+		return false;
+	}
+	while (length > 0)
+	{
+		DWORD written = 0;
+		if (!WriteFile(_file, next, static_cast<DWORD>(length), &written, nullptr) || written == 0)
+		{
+			return false;
+		}
+		next += written;
+		length -= written;
+	}
+#else
+	while (length > 0)
+	{
+		ssize_t written = pwrite(_fd, next, length, static_cast<off_t>(offset));
+		if (written <= 0)
+		{
+			return false;
+		}
+		next += written;
+		offset += static_cast<uint64_t>(written);
+		length -= static_cast<size_t>(written);
+	}
+#endif
+	return true;
+}
+
+bool chain_file::truncate(uint64_t length) noexcept
+{
+#if defined(_WIN32)
+	LARGE_INTEGER position;
+	position.QuadPart = static_cast<LONGLONG>(length);
+	return SetFilePointerEx(_file, position, nullptr, FILE_BEGIN) && SetEndOfFile(_file);
+#else
+	return ftruncate(_fd, static_cast<off_t>(length)) == 0;
+#endif
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sha256.h"
+
+class block;
+
+// The fixed part of one block as it is laid out in a chain file.  The
+// block's data follows straight after it, then zero padding up to a
+// multiple of 8 bytes so the next record is aligned and can be read
+// in place from the mapping.
+struct block_record
+{
+	// Bits in flags.
+	static constexpr uint32_t NONCE_LAST = 1;
+	// Set unless the block was never mined (the genesis block).
+	static constexpr uint32_t HAS_HASH = 2;
+	// Set unless the block follows an unmined one.
+	static constexpr uint32_t HAS_PREV_HASH = 4;
+
+	uint32_t index;
+	uint32_t flags;
+	uint64_t nonce;
+	int64_t time;
+	uint32_t data_length;
+	uint32_t reserved;
+	// Raw digests, rather than 64 characters of hex each.
+	unsigned char prev_hash[SHA256::DIGEST_SIZE];
+	unsigned char hash[SHA256::DIGEST_SIZE];
+
+	inline const char *data() const noexcept { return reinterpret_cast<const char*>(this + 1); }
+};
+
+static_assert(sizeof(block_record) == 96, "block_record must match the on-disk layout");
+
+// An append-only file of block records, read back through a memory
+// mapping.  Opening walks the records once to find where each one
+// starts, so loading a chain costs a single pass over the mapping and
+// one vector of offsets rather than an allocation per block.
+class chain_file
+{
+private:
+#if defined(_WIN32)
+	void *_file;
+	void *_mapping;
+#else
+	int _fd;
+#endif
+	const unsigned char *_view;
+	// Bytes of the file holding whole records, including the file header.
+	uint64_t _length;
+	// Where each record starts within the file.
+	std::vector<uint64_t> _offsets;
+
+	bool map() noexcept;
+	void unmap() noexcept;
+	bool write_at(uint64_t offset, const void *bytes, size_t length) noexcept;
+	bool truncate(uint64_t length) noexcept;
+
+public:
+	chain_file();
+	~chain_file();
+
+	chain_file(const chain_file&) = delete;
+	chain_file& operator=(const chain_file&) = delete;
+
+	// Opens the file at path, creating it if needed.  A last record cut
+	// short by a crash mid-append is dropped.  Returns false, leaving
+	// the file as it was, if it can't be opened, isn't a chain file or
+	// is damaged anywhere but its tail.
+	bool open(const std::string &path);
+	void close() noexcept;
+
+	inline bool is_open() const noexcept { return _length != 0; }
+	inline size_t size() const noexcept { return _offsets.size(); }
+
+	// Records point into the mapping, so they are only valid
+	// until the next append or close.
+	inline const block_record& operator[](size_t i) const noexcept { return *reinterpret_cast<const block_record*>(_view + _offsets[i]); }
+	inline const block_record& back() const noexcept { return (*this)[_offsets.size() - 1]; }
+
+	// Writes the block to the end of the file and maps it in.  If it
+	// can't be mapped in, the file is closed.
+	bool append(const block &b);
+};
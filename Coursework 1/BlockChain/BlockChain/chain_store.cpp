@@ -0,0 +1,59 @@
+#include "chain_store.h"
+#include "block_chain.h"
+
+using namespace std;
+
+void chain_store::append(block &&b)
+{
+	_index.push_back(b._index);
+	_nonce.push_back(b._nonce);
+	_time.push_back(b._time);
+	_flags.push_back(static_cast<uint8_t>((b.nonce_last ? NONCE_LAST : 0) | (b._has_hash ? HAS_HASH : 0)));
+	_hash.push_back(b._hash);
+
+	_data.insert(_data.end(), b._data.begin(), b._data.end());
+	_data_end.push_back(_data.size());
+
+	for (auto &t : b._transactions)
+	{
+		_tx_data.insert(_tx_data.end(), t.begin(), t.end());
+		_tx_end.push_back(_tx_data.size());
+	}
+	_block_tx_end.push_back(_tx_end.size());
+
+	// The block's own copies go now rather than when the caller's goes.
+	block spent(move(b));
+}
+
+void chain_store::clear() noexcept
+{
+	_index.clear();
+	_nonce.clear();
+	_time.clear();
+	_flags.clear();
+	_hash.clear();
+	_data_end.clear();
+	_data.clear();
+	_block_tx_end.clear();
+	_tx_end.clear();
+	_tx_data.clear();
+}
+
+block chain_store::get(size_t i) const
+{
+	block b(_index[i], string(data(i), data_length(i)));
+	b._nonce = _nonce[i];
+	b._time = static_cast<long>(_time[i]);
+	b._hash = _hash[i];
+	b._has_hash = has_hash(i);
+	b.nonce_last = nonce_last(i);
+	if (i > 0 && has_hash(i - 1))
+	{
+		b.prev_hash = sha256_hex(_hash[i - 1].data());
+	}
+	for (size_t t = 0; t < transaction_count(i); ++t)
+	{
+		b._transactions.emplace_back(transaction(i, t), transaction_length(i, t));
+	}
+	return b;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sha256.h"
+
+class block;
+
+// The blocks of a chain once they have been mined.  Each fixed-size
+// field lives in its own array and hashes are kept as raw digests, so a
+// scan over, say, every hash only touches hashes.  Block data and
+// transactions are packed end to end in arenas rather than each being
+// a string of its own.  A block's prev_hash isn't kept: it is always the
+// hash of the block stored before it.
+class chain_store
+{
+private:
+	std::vector<uint32_t> _index;
+	std::vector<uint64_t> _nonce;
+	std::vector<int64_t> _time;
+	std::vector<uint8_t> _flags;
+	std::vector<sha256_digest> _hash;
+
+	// Block i's data is _data[_data_end[i - 1], _data_end[i]).
+	std::vector<uint64_t> _data_end;
+	std::vector<char> _data;
+
+	// Block i's transactions are numbers [_block_tx_end[i - 1], _block_tx_end[i]),
+	// and transaction t is _tx_data[_tx_end[t - 1], _tx_end[t]).
+	std::vector<uint64_t> _block_tx_end;
+	std::vector<uint64_t> _tx_end;
+	std::vector<char> _tx_data;
+
+	inline uint64_t data_begin(size_t i) const noexcept { return i == 0 ? 0 : _data_end[i - 1]; }
+	inline uint64_t tx_begin(size_t i) const noexcept { return i == 0 ? 0 : _block_tx_end[i - 1]; }
+	inline uint64_t tx_data_begin(size_t t) const noexcept { return t == 0 ? 0 : _tx_end[t - 1]; }
+
+public:
+	static const uint8_t NONCE_LAST = 1;
+	static const uint8_t HAS_HASH = 2;
+
+	// Takes the block over.  Its data and transactions are copied into
+	// the arenas and its own strings freed along with it.
+	void append(block &&b);
+	void clear() noexcept;
+
+	inline size_t size() const noexcept { return _index.size(); }
+	inline bool empty() const noexcept { return _index.empty(); }
+
+	inline uint32_t index(size_t i) const noexcept { return _index[i]; }
+	inline uint64_t nonce(size_t i) const noexcept { return _nonce[i]; }
+	inline int64_t time(size_t i) const noexcept { return _time[i]; }
+	inline bool nonce_last(size_t i) const noexcept { return (_flags[i] & NONCE_LAST) != 0; }
+	inline bool has_hash(size_t i) const noexcept { return (_flags[i] & HAS_HASH) != 0; }
+	inline const sha256_digest& hash(size_t i) const noexcept { return _hash[i]; }
+
+	inline const char* data(size_t i) const noexcept { return _data.data() + data_begin(i); }
+	inline size_t data_length(size_t i) const noexcept { return static_cast<size_t>(_data_end[i] - data_begin(i)); }
+
+	inline size_t transaction_count(size_t i) const noexcept { return static_cast<size_t>(_block_tx_end[i] - tx_begin(i)); }
+	// The t'th transaction of block i.
+	inline const char* transaction(size_t i, size_t t) const noexcept { return _tx_data.data() + tx_data_begin(tx_begin(i) + t); }
+	inline size_t transaction_length(size_t i, size_t t) const noexcept
+	{
+		uint64_t n = tx_begin(i) + t;
+		return static_cast<size_t>(_tx_end[n] - tx_data_begin(n));
+	}
+
+	// Builds block i back up as a block of its own.  Its prev_hash is
+	// the hash of block i - 1, so is left empty for the first one stored.
+	block get(size_t i) const;
+};
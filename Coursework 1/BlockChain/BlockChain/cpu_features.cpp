@@ -0,0 +1,99 @@
+#include "cpu_features.h"
+
+#if defined(CPU_FEATURES_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#include <cstdint>
+
+#if defined(CPU_FEATURES_X86)
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) noexcept
+{
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; ++i)
+        regs[i] = static_cast<uint32_t>(r[i]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// The OS has to save the YMM registers on a context switch before
+// AVX code is safe to run, which is what XCR0 bits 1 and 2 report.
+static bool os_saves_ymm() noexcept
+{
+    uint32_t regs[4];
+    cpuid(1, 0, regs);
+    // OSXSAVE
+    if (!(regs[2] & (1u << 27)))
+        return false;
+#if defined(_MSC_VER)
+    uint64_t xcr0 = _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    uint64_t xcr0 = (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+    return (xcr0 & 0x6) == 0x6;
+}
+#endif
+
+bool cpu_has_sse2() noexcept
+{
+#if defined(CPU_FEATURES_X86)
+    static const bool has = []
+    {
+        uint32_t regs[4];
+        cpuid(1, 0, regs);
+        return (regs[3] & (1u << 26)) != 0;
+    }();
+    return has;
+#else
+    return false;
+#endif
+}
+
+bool cpu_has_avx2() noexcept
+{
+#if defined(CPU_FEATURES_X86)
+    static const bool has = []
+    {
+        uint32_t regs[4];
+        cpuid(0, 0, regs);
+        if (regs[0] < 7)
+            return false;
+        cpuid(7, 0, regs);
+        return (regs[1] & (1u << 5)) != 0 && os_saves_ymm();
+    }();
+    return has;
+#else
+    return false;
+#endif
+}
+
+bool cpu_has_sha() noexcept
+{
+#if defined(CPU_FEATURES_X86)
+    static const bool has = []
+    {
+        uint32_t regs[4];
+        cpuid(0, 0, regs);
+        if (regs[0] < 7)
+            return false;
+        cpuid(1, 0, regs);
+        // SSSE3 and SSE4.1
+        if (!(regs[2] & (1u << 9)) || !(regs[2] & (1u << 19)))
+            return false;
+        cpuid(7, 0, regs);
+        return (regs[1] & (1u << 29)) != 0;
+    }();
+    return has;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_FEATURES_X86
+#endif
+
+// MSVC will emit any intrinsic anywhere, but GCC and Clang need each
+// function told which extension it is allowed to use.
+#if defined(__GNUC__)
+#define CPU_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CPU_TARGET(isa)
+#endif
+
+// Runtime checks for the instruction set extensions the hashing code can
+// use.  Each result is worked out once and cached.
+bool cpu_has_sse2() noexcept;
+bool cpu_has_avx2() noexcept;
+// The SHA extensions, along with the SSSE3 and SSE4.1 shuffles the
+// SHA-NI code path also needs.
+bool cpu_has_sha() noexcept;
@@ -0,0 +1,65 @@
+#include "hash_index.h"
+
+using namespace std;
+
+void hash_index::allocate(size_t count)
+{
+	// A power of two at least twice count, so probes stay short.
+	size_t capacity = 16;
+	while (capacity < 2 * count)
+	{
+		capacity *= 2;
+	}
+	_slots.reset(new slot[capacity]);
+	for (size_t i = 0; i < capacity; ++i)
+	{
+		_slots[i].entry.store(0, memory_order_relaxed);
+		_slots[i].tag = 0;
+	}
+	_capacity = capacity;
+	_count = 0;
+}
+
+void hash_index::place(uint64_t tag, uint64_t position) noexcept
+{
+	const size_t mask = _capacity - 1;
+	for (size_t i = static_cast<size_t>(tag) & mask; ; i = (i + 1) & mask)
+	{
+		uint64_t expected = 0;
+		if (_slots[i].entry.load(memory_order_relaxed) == 0 && _slots[i].entry.compare_exchange_strong(expected, position + 1, memory_order_relaxed))
+		{
+			// Nobody reads tags until the rebuild has finished.
+			_slots[i].tag = tag;
+			return;
+		}
+	}
+}
+
+void hash_index::clear() noexcept
+{
+	_slots.reset();
+	_capacity = 0;
+	_count = 0;
+}
+
+void hash_index::insert(const unsigned char *digest, uint64_t position)
+{
+	if (2 * (_count + 1) > _capacity)
+	{
+		// Move everything over to a table twice the size.
+		unique_ptr<slot[]> old = move(_slots);
+		size_t old_capacity = _capacity;
+		allocate(_count + 1);
+		for (size_t i = 0; i < old_capacity; ++i)
+		{
+			uint64_t entry = old[i].entry.load(memory_order_relaxed);
+			if (entry != 0)
+			{
+				place(old[i].tag, entry - 1);
+				++_count;
+			}
+		}
+	}
+	place(tag_of(digest), position);
+	++_count;
+}
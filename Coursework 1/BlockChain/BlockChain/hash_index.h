@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "sha256.h"
+
+// Maps block hashes to chain positions in an open-addressed table with
+// linear probing.  A slot holds only a 64 bit tag taken from the hash
+// and the position, so the table stays small and a probe stays within a
+// cache line or two; a tag match is confirmed against the chain's own
+// copy of the hash, fetched through hash_at(position), which returns the
+// raw digest or nullptr for a block without one.  The table is kept at
+// most half full.
+class hash_index
+{
+private:
+	struct slot
+	{
+		// Position + 1, or 0 for an empty slot.  Atomic only so a
+		// rebuild can claim slots from several threads at once.
+		std::atomic<uint64_t> entry;
+		uint64_t tag;
+	};
+
+	std::unique_ptr<slot[]> _slots;
+	size_t _capacity = 0;
+	size_t _count = 0;
+
+	// Mined hashes start with zeros, so the tag comes from the other end.
+	static inline uint64_t tag_of(const unsigned char *digest) noexcept
+	{
+		uint64_t tag;
+		memcpy(&tag, digest + SHA256::DIGEST_SIZE - sizeof(tag), sizeof(tag));
+		return tag;
+	}
+
+	// An empty table with room for count entries.
+	void allocate(size_t count);
+	// Claims the first free slot from the tag's home; safe from several threads.
+	void place(uint64_t tag, uint64_t position) noexcept;
+
+public:
+	inline size_t size() const noexcept { return _count; }
+	void clear() noexcept;
+
+	// Adds one block, growing the table as needed.
+	void insert(const unsigned char *digest, uint64_t position);
+
+	// Finds the position of the block with the given hash.
+	template <typename HashAt>
+	bool find(const unsigned char *digest, const HashAt &hash_at, uint64_t &position) const noexcept
+	{
+		if (_capacity == 0)
+			return false;
+		const uint64_t tag = tag_of(digest);
+		const size_t mask = _capacity - 1;
+		for (size_t i = static_cast<size_t>(tag) & mask; ; i = (i + 1) & mask)
+		{
+			uint64_t entry = _slots[i].entry.load(std::memory_order_relaxed);
+			if (entry == 0)
+				return false;
+			if (_slots[i].tag != tag)
+				continue;
+			const unsigned char *candidate = hash_at(entry - 1);
+			if (candidate != nullptr && memcmp(candidate, digest, SHA256::DIGEST_SIZE) == 0)
+			{
+				position = entry - 1;
+				return true;
+			}
+		}
+	}
+
+	// Replaces the contents with positions [0, count), hashing them into
+	// the table from num_threads threads at once.
+	template <typename HashAt>
+	void rebuild(size_t count, const HashAt &hash_at, int num_threads)
+	{
+		allocate(count);
+		const long long n = static_cast<long long>(count);
+		long long added = 0;
+#pragma omp parallel for schedule(static) num_threads(num_threads) reduction(+:added)
+		for (long long p = 0; p < n; ++p)
+		{
+			const unsigned char *digest = hash_at(static_cast<size_t>(p));
+			if (digest != nullptr)
+			{
+				place(tag_of(digest), static_cast<uint64_t>(p));
+				++added;
+			}
+		}
+		_count = static_cast<size_t>(added);
+	}
+};
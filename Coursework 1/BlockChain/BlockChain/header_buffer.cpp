@@ -0,0 +1,50 @@
+#include "header_buffer.h"
+
+using namespace std;
+
+header_buffer::header_buffer()
+	: _start(MAX_DIGITS), _nonce(0)
+{
+}
+
+void header_buffer::reset(uint64_t nonce, const string &suffix)
+{
+	_buf.assign(MAX_DIGITS, '0');
+	_buf.append(suffix);
+	_nonce = nonce;
+
+	// Write the digits backwards from the end of the nonce field.
+	_start = MAX_DIGITS;
+	do
+	{
+		_buf[--_start] = static_cast<char>('0' + nonce % 10);
+		nonce /= 10;
+	} while (nonce != 0);
+}
+
+void header_buffer::advance(uint64_t step) noexcept
+{
+	_nonce += step;
+
+	// Add step column by column from the units digit, carrying left.
+	// Columns in front of the leading digit are already '0', so a
+	// carry past it just moves _start back.
+	size_t pos = MAX_DIGITS;
+	uint64_t carry = step;
+	while (carry != 0 && pos > 0)
+	{
+		--pos;
+		uint64_t sum = static_cast<uint64_t>(_buf[pos] - '0') + carry % 10;
+		carry /= 10;
+		if (sum >= 10)
+		{
+			sum -= 10;
+			++carry;
+		}
+		_buf[pos] = static_cast<char>('0' + sum);
+	}
+	if (pos < _start)
+	{
+		_start = pos;
+	}
+}
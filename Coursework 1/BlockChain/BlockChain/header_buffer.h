@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// The part of a block header from the nonce onwards, kept preformatted
+// so a worker can step through nonces without rebuilding any strings.
+// The nonce's decimal digits sit right-aligned against the suffix and
+// are incremented in place like an odometer.  When the nonce gains a
+// digit the text just starts one character earlier, so nothing moves
+// and nothing is allocated after reset().
+class header_buffer
+{
+private:
+	// Enough room for any uint64_t in decimal.
+	static constexpr size_t MAX_DIGITS = 20;
+
+	// MAX_DIGITS characters of room for the nonce, then the suffix.
+	std::string _buf;
+	// Index of the nonce's leading digit within _buf.
+	size_t _start;
+	uint64_t _nonce;
+
+public:
+	header_buffer();
+
+	// Formats nonce followed by suffix.  This is the only call
+	// that allocates.
+	void reset(uint64_t nonce, const std::string &suffix);
+
+	// Adds step to the nonce, rewriting only the digits that change.
+	void advance(uint64_t step) noexcept;
+
+	inline uint64_t nonce() const noexcept { return _nonce; }
+	inline const unsigned char *data() const noexcept { return reinterpret_cast<const unsigned char*>(_buf.data()) + _start; }
+	inline size_t length() const noexcept { return _buf.size() - _start; }
+};
@@ -0,0 +1,88 @@
+#include "mempool.h"
+
+using namespace std;
+
+mempool::mempool()
+	: _head(&_stub), _tail(&_stub)
+{
+	_stub.next.store(nullptr);
+}
+
+mempool::~mempool()
+{
+	// Nothing can be pushing now, so every node is complete.
+	node *n;
+	while ((n = pop_node()) != nullptr)
+	{
+		delete n;
+	}
+}
+
+void mempool::push_node(node *n) noexcept
+{
+	n->next.store(nullptr, memory_order_relaxed);
+	node *prev = _head.exchange(n, memory_order_acq_rel);
+	// Until this store lands the assembler sees the queue end at prev.
+	prev->next.store(n, memory_order_release);
+}
+
+mempool::node* mempool::pop_node() noexcept
+{
+	node *tail = _tail;
+	node *next = tail->next.load(memory_order_acquire);
+	// Step over the stub.
+	if (tail == &_stub)
+	{
+		if (next == nullptr)
+		{
+			return nullptr;
+		}
+		_tail = next;
+		tail = next;
+		next = next->next.load(memory_order_acquire);
+	}
+	if (next != nullptr)
+	{
+		_tail = next;
+		return tail;
+	}
+	// tail looks like the last node.  If it isn't, a producer is part
+	// way through pushing after it, so come back for it next time.
+	if (tail != _head.load(memory_order_acquire))
+	{
+		return nullptr;
+	}
+	// Put the stub behind it, so it can be taken without leaving the queue empty.
+	push_node(&_stub);
+	next = tail->next.load(memory_order_acquire);
+	if (next != nullptr)
+	{
+		_tail = next;
+		return tail;
+	}
+	return nullptr;
+}
+
+void mempool::push(string transaction)
+{
+	node *n = new node;
+	n->transaction = move(transaction);
+	push_node(n);
+}
+
+size_t mempool::drain(vector<string> &out, size_t max)
+{
+	size_t taken = 0;
+	while (taken < max)
+	{
+		node *n = pop_node();
+		if (n == nullptr)
+		{
+			break;
+		}
+		out.push_back(move(n->transaction));
+		delete n;
+		++taken;
+	}
+	return taken;
+}
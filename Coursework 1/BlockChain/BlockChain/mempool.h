@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Transactions waiting to go into a block.  Any number of threads can
+// push at once without locking or waiting on each other, while a single
+// block assembler drains them in the order their pushes completed.
+// The queue is Vyukov's intrusive MPSC queue: a push is one atomic
+// exchange plus a store, and draining never waits for a producer.  A
+// push caught half way is just left for the next drain.
+class mempool
+{
+private:
+	struct node
+	{
+		std::atomic<node*> next;
+		std::string transaction;
+	};
+
+	// Where producers add to; only ever swapped.
+	std::atomic<node*> _head;
+	// Where the assembler takes from.  Only it touches this.
+	node *_tail;
+	// Keeps the queue from ever being empty, so producers never touch _tail.
+	node _stub;
+
+	void push_node(node *n) noexcept;
+	// Returns the oldest complete node, or nullptr if there isn't one yet.
+	node* pop_node() noexcept;
+
+public:
+	mempool();
+	~mempool();
+
+	mempool(const mempool&) = delete;
+	mempool& operator=(const mempool&) = delete;
+
+	// Safe from any number of threads at once.
+	void push(std::string transaction);
+
+	// Moves up to max of the oldest transactions onto the end of out
+	// and returns how many.  Only one thread may drain at a time.
+	size_t drain(std::vector<std::string> &out, size_t max);
+};
@@ -0,0 +1,97 @@
+#include "merkle.h"
+#include "sha256_multi.h"
+
+#include <cstring>
+#include <omp.h>
+
+using namespace std;
+
+// Prefixes that keep a leaf from passing for a parent, or the reverse.
+static const unsigned char LEAF_PREFIX = 0x00;
+static const unsigned char NODE_PREFIX = 0x01;
+
+// Hashes prefix + each message in msgs into digests.  Both are padded
+// out to a whole number of batches first; the spare lanes rehash
+// message 0.
+static void hash_level(unsigned char prefix, vector<const unsigned char*> &msgs, vector<size_t> &lengths, vector<sha256_digest> &digests, int num_threads)
+{
+	size_t count = msgs.size();
+	size_t padded = (count + SHA256_LANES - 1) / SHA256_LANES * SHA256_LANES;
+	const unsigned char *spare = msgs[0];
+	size_t spare_length = lengths[0];
+	msgs.resize(padded, spare);
+	lengths.resize(padded, spare_length);
+	digests.resize(padded);
+
+	SHA256 initial;
+	initial.init();
+	initial.update(&prefix, 1);
+	const int num_batches = static_cast<int>(padded / SHA256_LANES);
+	// Small levels near the root aren't worth waking threads for.
+#pragma omp parallel for schedule(static) num_threads(num_threads) if(num_batches > 1)
+	for (int b = 0; b < num_batches; ++b)
+	{
+		size_t first = static_cast<size_t>(b) * SHA256_LANES;
+		sha256_multi(initial, &msgs[first], &lengths[first], reinterpret_cast<unsigned char (*)[SHA256::DIGEST_SIZE]>(digests[first].data()));
+	}
+
+	msgs.resize(count);
+	lengths.resize(count);
+	digests.resize(count);
+}
+
+sha256_digest merkle_root(const vector<string> &transactions, unsigned int num_threads)
+{
+	vector<const unsigned char*> msgs(transactions.size());
+	vector<size_t> lengths(transactions.size());
+	for (size_t i = 0; i < transactions.size(); ++i)
+	{
+		msgs[i] = reinterpret_cast<const unsigned char*>(transactions[i].data());
+		lengths[i] = transactions[i].length();
+	}
+	return merkle_root(msgs.data(), lengths.data(), msgs.size(), num_threads);
+}
+
+sha256_digest merkle_root(const unsigned char *const *transactions, const size_t *transaction_lengths, size_t count, unsigned int num_threads)
+{
+	if (count == 0)
+	{
+		return sha256_raw(string());
+	}
+	const int threads = num_threads == 0 ? omp_get_max_threads() : static_cast<int>(num_threads);
+
+	// The leaves.
+	vector<const unsigned char*> msgs(transactions, transactions + count);
+	vector<size_t> lengths(transaction_lengths, transaction_lengths + count);
+	vector<sha256_digest> level;
+	hash_level(LEAF_PREFIX, msgs, lengths, level, threads);
+
+	// Every level above them hashes the prefix and a 64 byte pair, so
+	// every lane has the same length and the multi-buffer engine never
+	// falls back.
+	vector<unsigned char> pairs;
+	vector<sha256_digest> next;
+	while (level.size() > 1)
+	{
+		size_t parents = level.size() / 2;
+		pairs.resize(parents * 2 * SHA256::DIGEST_SIZE);
+		msgs.resize(parents);
+		lengths.assign(parents, 2 * SHA256::DIGEST_SIZE);
+		for (size_t i = 0; i < parents; ++i)
+		{
+			unsigned char *pair = &pairs[i * 2 * SHA256::DIGEST_SIZE];
+			memcpy(pair, level[2 * i].data(), SHA256::DIGEST_SIZE);
+			memcpy(pair + SHA256::DIGEST_SIZE, level[2 * i + 1].data(), SHA256::DIGEST_SIZE);
+			msgs[i] = pair;
+		}
+		hash_level(NODE_PREFIX, msgs, lengths, next, threads);
+		// An odd node out goes up a level as it is.  Pairing it with
+		// itself would give [a, b, c] the same root as [a, b, c, c].
+		if (level.size() % 2 != 0)
+		{
+			next.push_back(level.back());
+		}
+		level.swap(next);
+	}
+	return level[0];
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "sha256.h"
+
+#include <string>
+#include <vector>
+
+// Summarises a block's transactions as the root of a binary hash tree.
+// Leaves are the SHA-256 of 0x00 and each transaction, and every parent
+// is the SHA-256 of 0x01 and its two children's digests side by side;
+// a level with an odd count passes its last node up unpaired, so no
+// two lists of transactions share a root.  Each level is hashed
+// SHA256_LANES nodes per call to the multi-buffer engine, with the
+// batches shared between num_threads threads (0 for one per hardware
+// thread).  No transactions gives the digest of the empty string.
+sha256_digest merkle_root(const std::vector<std::string> &transactions, unsigned int num_threads = 0);
+// The same, for count transactions that are already laid out in memory.
+sha256_digest merkle_root(const unsigned char *const *transactions, const size_t *lengths, size_t count, unsigned int num_threads = 0);
@@ -0,0 +1,175 @@
+#include "mining_checkpoint.h"
+#include "mining_strategy.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+
+namespace
+{
+	const char MAGIC[4] = { 'B', 'C', 'K', 'P' };
+	const uint32_t VERSION = 1;
+
+	// Everything of fixed size, ahead of the prefix and suffix bytes.
+	struct checkpoint_header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t difficulty;
+		uint32_t prefix_length;
+		uint32_t suffix_length;
+		uint32_t reserved;
+		uint64_t next_nonce;
+		uint64_t nonce_spacing;
+	};
+}
+
+bool mining_checkpoint::save(const string &path) const noexcept
+{
+	checkpoint_header header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.difficulty = difficulty;
+	header.prefix_length = static_cast<uint32_t>(prefix.length());
+	header.suffix_length = static_cast<uint32_t>(suffix.length());
+	header.reserved = 0;
+	header.next_nonce = next_nonce;
+	header.nonce_spacing = nonce_spacing;
+
+	string temp = path + ".tmp";
+	{
+		ofstream file(temp, ofstream::binary | ofstream::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(prefix.data(), prefix.length());
+		file.write(suffix.data(), suffix.length());
+		file.flush();
+		if (!file)
+		{
+			return false;
+		}
+	}
+	// Windows won't rename over an existing file.
+	if (rename(temp.c_str(), path.c_str()) != 0)
+	{
+		remove(path.c_str());
+		return rename(temp.c_str(), path.c_str()) == 0;
+	}
+	return true;
+}
+
+bool mining_checkpoint::load(const string &path) noexcept
+{
+	ifstream file(path, ifstream::binary);
+	checkpoint_header header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+	{
+		return false;
+	}
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION)
+	{
+		return false;
+	}
+	// Header fields are well under a block, so anything bigger is garbage.
+	const uint32_t MAX_FIELD = 1 << 24;
+	if (header.prefix_length > MAX_FIELD || header.suffix_length > MAX_FIELD)
+	{
+		return false;
+	}
+	string p(header.prefix_length, '\0');
+	string s(header.suffix_length, '\0');
+	if (!file.read(&p[0], p.length()) || !file.read(&s[0], s.length()))
+	{
+		return false;
+	}
+	prefix = move(p);
+	suffix = move(s);
+	difficulty = header.difficulty;
+	next_nonce = header.next_nonce;
+	nonce_spacing = header.nonce_spacing;
+	return true;
+}
+
+bool mining_checkpoint::matches(const string &other_prefix, const string &other_suffix, uint32_t other_difficulty, uint64_t other_spacing) const noexcept
+{
+	return prefix == other_prefix && suffix == other_suffix && difficulty == other_difficulty && nonce_spacing == other_spacing;
+}
+
+checkpoint_saver::checkpoint_saver(const string &path, unsigned int seconds)
+	: _path(path), _seconds(seconds), _job(nullptr), _outcome(nullptr), _generation(0), _stop(false)
+{
+	_saver = thread(&checkpoint_saver::saver_loop, this);
+}
+
+checkpoint_saver::~checkpoint_saver()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_stop = true;
+	}
+	_wake.notify_one();
+	_saver.join();
+}
+
+bool checkpoint_saver::claim(const mining_checkpoint &block, uint64_t &resume_from)
+{
+	mining_checkpoint saved;
+	if (saved.load(_path))
+	{
+		if (!saved.matches(block.prefix, block.suffix, block.difficulty, block.nonce_spacing))
+		{
+			return false;
+		}
+		resume_from = saved.next_nonce;
+	}
+	lock_guard<mutex> lock(_mutex);
+	_checkpoint = block;
+	return true;
+}
+
+void checkpoint_saver::watch(const mining_job &job, const mining_outcome &outcome)
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_job = &job;
+		_outcome = &outcome;
+		++_generation;
+	}
+	_wake.notify_one();
+}
+
+void checkpoint_saver::finish()
+{
+	{
+		// Taking the lock waits out any save in progress, so the file
+		// can't be written again once it has gone.
+		lock_guard<mutex> lock(_mutex);
+		_job = nullptr;
+		_outcome = nullptr;
+		++_generation;
+		remove(_path.c_str());
+	}
+	_wake.notify_one();
+}
+
+void checkpoint_saver::saver_loop()
+{
+	unique_lock<mutex> lock(_mutex);
+	while (!_stop)
+	{
+		uint64_t generation = _generation;
+		if (_job == nullptr)
+		{
+			_wake.wait(lock, [&] { return _stop || _generation != generation; });
+			continue;
+		}
+		// Timing out means a whole period passed on the same block.
+		if (!_wake.wait_for(lock, std::chrono::seconds(_seconds), [&] { return _stop || _generation != generation; }))
+		{
+			_checkpoint.next_nonce = searched_up_to(*_job, *_outcome);
+			_checkpoint.save(_path);
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct mining_job;
+struct mining_outcome;
+
+// How far the search for one block has got, saved so a miner that is
+// restarted can carry on instead of going over the same nonces again.
+// The block is identified by everything hashed around the nonce, so a
+// checkpoint is only ever picked up by the block it was taken from.
+struct mining_checkpoint
+{
+	// The header bytes before and after the nonce.
+	std::string prefix;
+	std::string suffix;
+	uint32_t difficulty = 0;
+	// Every nonce of the search below this has been tried.
+	uint64_t next_nonce = 1;
+	uint64_t nonce_spacing = 1;
+
+	// Writes to a temporary file first and renames it over path, so a
+	// crash part way through leaves the previous checkpoint intact.
+	bool save(const std::string &path) const noexcept;
+	// Returns false if there is no readable checkpoint at path.
+	bool load(const std::string &path) noexcept;
+
+	// Whether this checkpoint was taken from the given search.
+	bool matches(const std::string &other_prefix, const std::string &other_suffix, uint32_t other_difficulty, uint64_t other_spacing) const noexcept;
+};
+
+// Saves the search in progress to a checkpoint file every few seconds,
+// from a thread of its own that is started once and kept for block
+// after block, so the search threads never wait on the disk.  The file
+// only ever holds one block's search: a block whose search isn't the
+// one in the file leaves it alone, so it is still there to resume once
+// that block comes round again.
+class checkpoint_saver
+{
+public:
+	checkpoint_saver(const std::string &path, unsigned int seconds);
+	~checkpoint_saver();
+
+	checkpoint_saver(const checkpoint_saver&) = delete;
+	checkpoint_saver& operator=(const checkpoint_saver&) = delete;
+
+	inline const std::string& path() const noexcept { return _path; }
+	inline unsigned int seconds() const noexcept { return _seconds; }
+
+	// Takes the file for the search described by block, ignoring its
+	// next_nonce.  If the file already holds this search, resume_from is
+	// set to where it got to, otherwise it is left alone.  Returns false
+	// if the file holds some other block's search.
+	bool claim(const mining_checkpoint &block, uint64_t &resume_from);
+	// Saves the claimed search's progress every few seconds until
+	// finish.  job and outcome must outlive the watch.
+	void watch(const mining_job &job, const mining_outcome &outcome);
+	// Stops watching and removes the file: finished or abandoned, the
+	// block won't be searched again.
+	void finish();
+
+private:
+	void saver_loop();
+
+	std::string _path;
+	unsigned int _seconds;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	// What is being saved, or null between blocks.
+	const mining_job *_job;
+	const mining_outcome *_outcome;
+	mining_checkpoint _checkpoint;
+	// Bumped per watch and finish, so the saver restarts its wait.
+	uint64_t _generation;
+	bool _stop;
+	std::thread _saver;
+};
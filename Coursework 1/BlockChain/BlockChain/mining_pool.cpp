@@ -0,0 +1,70 @@
+#include "mining_pool.h"
+#include "trace.h"
+
+#include <string>
+
+using namespace std;
+
+mining_pool::mining_pool(unsigned int num_threads)
+	: _size(num_threads == 0 ? 1 : num_threads), _job(nullptr), _generation(0), _running(0), _stop(false)
+{
+	// _size keeps at least one worker, even if the
+	// processor count is unknown.
+	for (unsigned int i = 0; i < _size; ++i)
+	{
+		_threads.push_back(thread(&mining_pool::worker_loop, this, i));
+	}
+}
+
+mining_pool::~mining_pool()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_stop = true;
+	}
+	_wake.notify_all();
+	for (auto &t : _threads)
+	{
+		t.join();
+	}
+}
+
+void mining_pool::run(const job &work)
+{
+	unique_lock<mutex> lock(_mutex);
+	_job = &work;
+	_running = size();
+	++_generation;
+	_wake.notify_all();
+	_done.wait(lock, [this] { return _running == 0; });
+	_job = nullptr;
+}
+
+void mining_pool::worker_loop(unsigned int id)
+{
+	trace_thread_name("pool worker " + to_string(id));
+	trace_scope scope("pool worker");
+	uint64_t seen = 0;
+	unique_lock<mutex> lock(_mutex);
+	while (true)
+	{
+		_wake.wait(lock, [&] { return _stop || _generation != seen; });
+		if (_stop)
+		{
+			return;
+		}
+		seen = _generation;
+		const job *work = _job;
+
+		// Run the job without holding the lock, so the workers
+		// actually run in parallel.
+		lock.unlock();
+		(*work)(id, size());
+		lock.lock();
+
+		if (--_running == 0)
+		{
+			_done.notify_one();
+		}
+	}
+}
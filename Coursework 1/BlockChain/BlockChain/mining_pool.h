@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that live as long as the pool.
+// Instead of spawning and joining threads for every block, run()
+// wakes the sleeping workers, hands each the same job, and returns
+// once all of them have finished it.
+class mining_pool
+{
+public:
+	// The job receives the worker's id and the number of workers.
+	typedef std::function<void(unsigned int, unsigned int)> job;
+
+	explicit mining_pool(unsigned int num_threads);
+	~mining_pool();
+
+	mining_pool(const mining_pool&) = delete;
+	mining_pool& operator=(const mining_pool&) = delete;
+
+	// Runs work on every worker and blocks until all have returned.
+	// Anything a worker wrote is visible to the caller afterwards.
+	void run(const job &work);
+
+	inline unsigned int size() const noexcept { return _size; }
+
+private:
+	void worker_loop(unsigned int id);
+
+	// Fixed before any worker starts, so workers can read it freely.
+	unsigned int _size;
+	std::vector<std::thread> _threads;
+	std::mutex _mutex;
+	// Signalled when a new job is posted, or on shutdown.
+	std::condition_variable _wake;
+	// Signalled when the last worker finishes the current job.
+	std::condition_variable _done;
+	const job *_job;
+	// Bumped per job so a worker never runs the same one twice.
+	uint64_t _generation;
+	unsigned int _running;
+	bool _stop;
+};
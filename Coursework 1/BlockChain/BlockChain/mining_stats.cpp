@@ -0,0 +1,129 @@
+#include "mining_stats.h"
+#include "mining_strategy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+using namespace std;
+
+uint64_t block_stats::attempts() const noexcept
+{
+	uint64_t total = 0;
+	for (auto &w : workers)
+		total += w.attempts;
+	return total;
+}
+
+uint64_t block_stats::wasted() const noexcept
+{
+	uint64_t total = 0;
+	for (auto &w : workers)
+		total += w.wasted;
+	return total;
+}
+
+uint64_t block_stats::steals() const noexcept
+{
+	uint64_t total = 0;
+	for (auto &w : workers)
+		total += w.steals;
+	return total;
+}
+
+double block_stats::idle_seconds() const noexcept
+{
+	double total = 0;
+	for (auto &w : workers)
+		total += w.idle_seconds;
+	return total;
+}
+
+double block_stats::busy_seconds() const noexcept
+{
+	double total = 0;
+	for (auto &w : workers)
+		total += w.busy_seconds;
+	return total;
+}
+
+block_stats summarise(const mining_outcome &outcome, uint32_t index, uint32_t difficulty, double seconds, double time_to_solution)
+{
+	block_stats stats;
+	stats.index = index;
+	stats.difficulty = difficulty;
+	stats.seconds = seconds;
+	stats.time_to_solution = time_to_solution;
+	for (auto &c : outcome.workers)
+	{
+		// Never started, such as threads OpenMP didn't hand out.
+		if (c.end == chrono::steady_clock::time_point())
+			continue;
+		worker_stats w;
+		w.attempts = c.attempts;
+		w.wasted = c.wasted;
+		w.steals = c.steals;
+		w.busy_seconds = chrono::duration<double>(c.end - c.begin).count();
+		w.idle_seconds = max(0.0, seconds - w.busy_seconds);
+		stats.workers.push_back(w);
+	}
+	return stats;
+}
+
+namespace
+{
+	// Everything in one histogram bucket.
+	struct bucket
+	{
+		size_t blocks = 0;
+		uint64_t attempts = 0;
+		uint64_t wasted = 0;
+		double time_to_solution = 0;
+		double busy_seconds = 0;
+		double idle_seconds = 0;
+		double seconds = 0;
+	};
+
+	// Bucket b holds block times up to 2^b microseconds.
+	int bucket_of(double seconds)
+	{
+		double us = seconds * 1e6;
+		return us <= 1 ? 0 : static_cast<int>(ceil(log2(us)));
+	}
+}
+
+void chain_stats::write_histograms(ostream &out) const
+{
+	map<uint32_t, map<int, bucket>> histograms;
+	for (auto &b : _blocks)
+	{
+		bucket &into = histograms[b.difficulty][bucket_of(b.seconds)];
+		++into.blocks;
+		into.attempts += b.attempts();
+		into.wasted += b.wasted();
+		into.time_to_solution += b.time_to_solution;
+		into.busy_seconds += b.busy_seconds();
+		into.idle_seconds += b.idle_seconds();
+		into.seconds += b.seconds;
+	}
+
+	out << "Difficulty" << "," << "Block Time Up To" << "," << "Blocks" << "," << "Mean Attempts" << "," << "Mean Wasted" << "," << "Mean Time To Solution" << "," << "Hash Rate" << "," << "Idle %" << endl;
+	for (auto &h : histograms)
+	{
+		// Empty buckets in between are kept, so the shape shows.
+		int first = h.second.begin()->first;
+		int last = h.second.rbegin()->first;
+		for (int b = first; b <= last; ++b)
+		{
+			auto found = h.second.find(b);
+			bucket empty;
+			const bucket &bk = found == h.second.end() ? empty : found->second;
+			double up_to = ldexp(1e-6, b);
+			double blocks = bk.blocks == 0 ? 1 : static_cast<double>(bk.blocks);
+			double rate = bk.seconds == 0 ? 0 : bk.attempts / bk.seconds;
+			double thread_seconds = bk.busy_seconds + bk.idle_seconds;
+			double idle = thread_seconds == 0 ? 0 : 100.0 * bk.idle_seconds / thread_seconds;
+			out << h.first << "," << up_to << "," << bk.blocks << "," << bk.attempts / blocks << "," << bk.wasted / blocks << "," << bk.time_to_solution / blocks << "," << rate << "," << idle << endl;
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+struct mining_outcome;
+
+// What one search thread did for a block.
+struct worker_stats
+{
+	uint64_t attempts;
+	uint64_t wasted;
+	// Times it took over part of another thread's share of the nonces.
+	uint64_t steals;
+	// Time spent hashing.
+	double busy_seconds;
+	// Time the block was being mined but this thread wasn't: waiting to
+	// be started or woken, and waiting for the others to stop.
+	double idle_seconds;
+};
+
+// How one block's mining went.
+struct block_stats
+{
+	uint32_t index;
+	uint32_t difficulty;
+	// From handing the job to the strategy until it returned.
+	double seconds;
+	// From handing the job to the strategy until the winner published.
+	double time_to_solution;
+	std::vector<worker_stats> workers;
+
+	uint64_t attempts() const noexcept;
+	uint64_t wasted() const noexcept;
+	uint64_t steals() const noexcept;
+	double idle_seconds() const noexcept;
+	double busy_seconds() const noexcept;
+};
+
+// Turns a finished outcome's counters into a block's stats.  Entries for
+// threads that never ran are left out.
+block_stats summarise(const mining_outcome &outcome, uint32_t index, uint32_t difficulty, double seconds, double time_to_solution);
+
+// Every block's stats for a chain, in the order they were mined.
+class chain_stats
+{
+private:
+	std::vector<block_stats> _blocks;
+
+public:
+	inline void add(block_stats &&stats) { _blocks.push_back(std::move(stats)); }
+	inline const std::vector<block_stats>& blocks() const noexcept { return _blocks; }
+	inline void clear() noexcept { _blocks.clear(); }
+
+	// Writes a CSV histogram of block times for each difficulty, in
+	// buckets doubling from a microsecond.  Alongside each bucket's count
+	// go its blocks' mean attempts, hash rate and idle share: slow blocks
+	// that needed more attempts were unlucky, while slow blocks with a
+	// low hash rate or lots of idling point at poor scaling.
+	void write_histograms(std::ostream &out) const;
+};
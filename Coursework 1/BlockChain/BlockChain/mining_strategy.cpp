@@ -0,0 +1,531 @@
+#include "mining_strategy.h"
+#include "sha256_multi.h"
+#include "header_buffer.h"
+#include "affinity.h"
+#include "mining_pool.h"
+#include "nonce_scheduler.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <omp.h>
+
+using namespace std;
+
+bool mining_outcome::publish(uint64_t winning_nonce, const unsigned char *winning_digest) noexcept
+{
+	// Only the first thread to flip the flag publishes its result.
+	bool expected = false;
+	if (!found.compare_exchange_strong(expected, true))
+	{
+		return false;
+	}
+	nonce = winning_nonce;
+	memcpy(digest.data(), winning_digest, SHA256::DIGEST_SIZE);
+	solved = chrono::steady_clock::now();
+	return true;
+}
+
+// Attempts between looks at the job's cancel flag.  A power of two,
+// and a multiple of SHA256_LANES.
+static const uint64_t CANCEL_CHECK_INTERVAL = 4096;
+
+// Tells a checkpoint every nonce before next has been tried.
+static inline void record_progress(mining_outcome &outcome, unsigned int worker, uint64_t next) noexcept
+{
+	if (worker < outcome.workers.size())
+	{
+		outcome.workers[worker].next_nonce.store(next, memory_order_relaxed);
+	}
+}
+
+uint64_t searched_up_to(const mining_job &job, const mining_outcome &outcome) noexcept
+{
+	if (!outcome.workers_sized.load(memory_order_acquire))
+	{
+		return job.first_nonce;
+	}
+	uint64_t lowest = UINT64_MAX;
+	for (auto &w : outcome.workers)
+	{
+		uint64_t next = w.next_nonce.load(memory_order_relaxed);
+		if (next == 0)
+			return job.first_nonce;
+		lowest = min(lowest, next);
+	}
+	return outcome.workers.empty() ? job.first_nonce : lowest;
+}
+
+// Files a search thread's counters, if the strategy asked for them.
+static void record_worker(mining_outcome &outcome, unsigned int worker, chrono::steady_clock::time_point begin, uint64_t attempts, uint64_t wasted) noexcept
+{
+	if (worker >= outcome.workers.size())
+	{
+		return;
+	}
+	worker_counters &counters = outcome.workers[worker];
+	counters.attempts = attempts;
+	counters.wasted = wasted;
+	counters.begin = begin;
+	counters.end = chrono::steady_clock::now();
+}
+
+// Pins the calling worker to its own CPU if the job gives a placement,
+// otherwise to the job's set of CPUs.
+static void pin_worker(const mining_job &job, unsigned int worker) noexcept
+{
+	if (job.worker_cpus.empty())
+	{
+		pin_current_thread(job.cpus);
+		return;
+	}
+	pin_current_thread(vector<unsigned int>(1, job.worker_cpus[worker % job.worker_cpus.size()]));
+}
+
+// Closes the trace span for the batch of hashes just finished and
+// starts timing the next.
+static inline void trace_batch(chrono::steady_clock::time_point &batch) noexcept
+{
+	if (tracing())
+	{
+		trace_span("hash batch", batch);
+		batch = chrono::steady_clock::now();
+	}
+}
+
+static unsigned int default_threads(unsigned int num_threads) noexcept
+{
+	// Default to the available threads relative to the processor.
+	if (num_threads == 0)
+	{
+		num_threads = thread::hardware_concurrency();
+	}
+	return num_threads == 0 ? 1 : num_threads;
+}
+
+void search_stride(const mining_job &job, uint64_t first, uint64_t stride, mining_outcome &outcome, unsigned int worker) noexcept
+{
+	trace_scope scope("search");
+	auto begin = chrono::steady_clock::now();
+	auto batch = begin;
+	// The tail is kept preformatted and its nonce stepped in
+	// place, so nothing in the loop below allocates.
+	header_buffer tail;
+	tail.reset(first, job.suffix);
+	unsigned char digest[SHA256::DIGEST_SIZE];
+	uint64_t attempts = 0;
+	record_progress(outcome, worker, first);
+
+	while (!outcome.found.load(memory_order_relaxed))
+	{
+		SHA256 ctx;
+		ctx.resume(job.midstate);
+		ctx.update(tail.data(), tail.length());
+		ctx.final(digest);
+		++attempts;
+		if (has_leading_zero_nibbles(digest, job.difficulty))
+		{
+			bool won = outcome.publish(tail.nonce(), digest);
+			record_worker(outcome, worker, begin, attempts, won ? 0 : 1);
+			return;
+		}
+		tail.advance(stride);
+		if (attempts % CANCEL_CHECK_INTERVAL == 0)
+		{
+			record_progress(outcome, worker, tail.nonce());
+			trace_batch(batch);
+			if (job.cancelled())
+				break;
+		}
+	}
+	record_worker(outcome, worker, begin, attempts, attempts > 0 ? 1 : 0);
+}
+
+void search_stride_lanes(const mining_job &job, uint64_t first, uint64_t stride, mining_outcome &outcome, unsigned int worker) noexcept
+{
+	trace_scope scope("search");
+	auto begin = chrono::steady_clock::now();
+	auto batch = begin;
+	// Each lane keeps its tail preformatted and steps its nonce
+	// in place, so nothing in the loop below allocates.
+	header_buffer lanes[SHA256_LANES];
+	const unsigned char *tails[SHA256_LANES];
+	size_t lengths[SHA256_LANES];
+	unsigned char digests[SHA256_LANES][SHA256::DIGEST_SIZE];
+	for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+	{
+		lanes[lane].reset(first + lane * job.nonce_spacing, job.suffix);
+	}
+	uint64_t attempts = 0;
+	record_progress(outcome, worker, first);
+
+	while (!outcome.found.load(memory_order_relaxed))
+	{
+		for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+		{
+			tails[lane] = lanes[lane].data();
+			lengths[lane] = lanes[lane].length();
+		}
+		sha256_multi(job.midstate, tails, lengths, digests);
+		attempts += SHA256_LANES;
+
+		// Lanes are checked in nonce order, so a lone thread
+		// still finds the same nonce as the serial miner.
+		for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+		{
+			if (has_leading_zero_nibbles(digests[lane], job.difficulty))
+			{
+				bool won = outcome.publish(lanes[lane].nonce(), digests[lane]);
+				record_worker(outcome, worker, begin, attempts, won ? 0 : SHA256_LANES);
+				return;
+			}
+		}
+		for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+		{
+			lanes[lane].advance(stride);
+		}
+		if (attempts % CANCEL_CHECK_INTERVAL == 0)
+		{
+			// Lane 0 holds this worker's lowest untried nonce.
+			record_progress(outcome, worker, lanes[0].nonce());
+			trace_batch(batch);
+			if (job.cancelled())
+				break;
+		}
+	}
+	record_worker(outcome, worker, begin, attempts, attempts > 0 ? SHA256_LANES : 0);
+}
+
+namespace
+{
+	// The original coursework miner: one thread, one nonce at a time.
+	class serial_strategy : public mining_strategy
+	{
+	public:
+		const char *name() const noexcept override { return "serial"; }
+
+		void mine(const mining_job &job, mining_outcome &outcome) override
+		{
+			outcome.size_workers(1);
+			pin_worker(job, 0);
+			search_stride(job, job.first_nonce, job.nonce_spacing, outcome);
+		}
+	};
+
+	// Spawns a std::thread per hardware thread for every block, each
+	// searching its own stride, and joins them once one has won.
+	class thread_strategy : public mining_strategy
+	{
+	public:
+		const char *name() const noexcept override { return "threads"; }
+
+		void mine(const mining_job &job, mining_outcome &outcome) override
+		{
+			unsigned int num_threads = default_threads(job.num_threads);
+			outcome.size_workers(num_threads);
+			vector<thread> threads;
+			for (unsigned int i = 0; i < num_threads; ++i)
+			{
+				threads.push_back(thread([&job, &outcome, i, num_threads]
+				{
+					trace_thread_name("search thread " + to_string(i));
+					pin_worker(job, i);
+					search_stride(job, job.first_nonce + i * job.nonce_spacing, num_threads * job.nonce_spacing, outcome, i);
+				}));
+			}
+			for (auto &t : threads)
+			{
+				t.join();
+			}
+		}
+	};
+
+	// An OpenMP parallel region per block, each thread on its own stride
+	// of SHA256_LANES nonces at a time through the multi-buffer engine.
+	class openmp_strategy : public mining_strategy
+	{
+	public:
+		const char *name() const noexcept override { return "openmp"; }
+
+		void mine(const mining_job &job, mining_outcome &outcome) override
+		{
+			int num_threads = static_cast<int>(default_threads(job.num_threads));
+#pragma omp parallel num_threads(num_threads) default(none) shared(job, outcome)
+			{
+				// OpenMP may hand out fewer threads than asked for, and a
+				// checkpoint waits on every entry, so size for the team.
+#pragma omp single
+				outcome.size_workers(static_cast<size_t>(omp_get_num_threads()));
+				// Thread 0 tries 1-8, then 1 + 8n..., thread 1 tries 9-16...
+				const uint64_t stride = static_cast<uint64_t>(omp_get_num_threads()) * SHA256_LANES * job.nonce_spacing;
+				const int id = omp_get_thread_num();
+				// Thread 0 is the caller's own, which keeps its name.
+				if (id != 0)
+					trace_thread_name("omp thread " + to_string(id));
+				pin_worker(job, static_cast<unsigned int>(id));
+				search_stride_lanes(job, job.first_nonce + static_cast<uint64_t>(id) * SHA256_LANES * job.nonce_spacing, stride, outcome, static_cast<unsigned int>(id));
+			}
+		}
+	};
+
+	// An OpenMP worksharing loop over fixed-size chunks of nonces, handed
+	// out in order with schedule(dynamic).  The nonce space has no end, so
+	// it is taken a round of chunks at a time.  A chunk that finds a
+	// solution folds its nonce into the winner, and the chunks after it
+	// are skipped as they come up.  Chunks before it still run, since one
+	// of them may hold a lower solution, so the winner is the lowest
+	// nonce that passes, the same one the serial miner finds.  The loop
+	// isn't cancelled with omp cancel, which would also drop chunks
+	// before the winner that had yet to start.
+	class openmp_cancel_strategy : public mining_strategy
+	{
+	public:
+		const char *name() const noexcept override { return "openmp-cancel"; }
+
+		// Chunks are handed out dynamically, so no worker's progress
+		// bounds what has been searched.
+		bool resumable() const noexcept override { return false; }
+
+		void mine(const mining_job &job, mining_outcome &outcome) override
+		{
+			// Long enough to keep scheduling cheap, short enough that
+			// threads stop soon after a win.
+			const int CHUNK = 4096;
+			int num_threads = static_cast<int>(default_threads(job.num_threads));
+			const int chunks_per_round = num_threads * 16;
+
+			// The spec leaves reduction variables undefined once a loop is
+			// cancelled, so the winner is a min folded in atomically instead.
+			atomic<uint64_t> winner(UINT64_MAX);
+			bool done = false;
+
+#pragma omp parallel num_threads(num_threads) default(none) shared(job, outcome, winner, done, chunks_per_round)
+			{
+#pragma omp single
+				outcome.size_workers(static_cast<size_t>(omp_get_num_threads()));
+				const unsigned int id = static_cast<unsigned int>(omp_get_thread_num());
+				if (id != 0)
+					trace_thread_name("omp thread " + to_string(id));
+				trace_scope scope("search");
+				pin_worker(job, id);
+				auto begin = chrono::steady_clock::now();
+				uint64_t attempts = 0;
+				uint64_t wasted = 0;
+				header_buffer tail;
+				unsigned char digest[SHA256::DIGEST_SIZE];
+
+				for (uint64_t round = 0; !done; ++round)
+				{
+#pragma omp for schedule(dynamic)
+					for (int c = 0; c < chunks_per_round; ++c)
+					{
+						const uint64_t chunk = round * static_cast<uint64_t>(chunks_per_round) + static_cast<uint64_t>(c);
+						const uint64_t first = job.first_nonce + chunk * CHUNK * job.nonce_spacing;
+						// Also stops for a win published by someone else, such as another rank.
+						if (first > winner.load(memory_order_relaxed) || outcome.found.load(memory_order_relaxed) || job.cancelled())
+						{
+							continue;
+						}
+
+						trace_scope batch("hash batch");
+						tail.reset(first, job.suffix);
+						bool won = false;
+						for (int k = 0; k < CHUNK; ++k)
+						{
+							SHA256 ctx;
+							ctx.resume(job.midstate);
+							ctx.update(tail.data(), tail.length());
+							ctx.final(digest);
+							++attempts;
+							if (has_leading_zero_nibbles(digest, job.difficulty))
+							{
+								won = true;
+								break;
+							}
+							tail.advance(job.nonce_spacing);
+						}
+						if (won)
+						{
+							uint64_t nonce = tail.nonce();
+							uint64_t current = winner.load();
+							while (nonce < current && !winner.compare_exchange_weak(current, nonce))
+							{
+							}
+						}
+						else if (first > winner.load(memory_order_relaxed))
+						{
+							// Started before a lower nonce won, so none of it counted.
+							wasted += CHUNK;
+						}
+					}
+
+					// Every thread has to agree whether to go round again.
+#pragma omp single
+					done = winner.load() != UINT64_MAX || outcome.found.load() || job.cancelled();
+				}
+				record_worker(outcome, id, begin, attempts, wasted);
+			}
+
+			uint64_t nonce = winner.load();
+			if (nonce == UINT64_MAX)
+			{
+				return;
+			}
+			// Only the nonce was kept, so hash the winner once more.
+			header_buffer tail;
+			tail.reset(nonce, job.suffix);
+			SHA256 ctx;
+			ctx.resume(job.midstate);
+			ctx.update(tail.data(), tail.length());
+			unsigned char digest[SHA256::DIGEST_SIZE];
+			ctx.final(digest);
+			outcome.publish(nonce, digest);
+		}
+	};
+
+	// A long-lived mining_pool, created with the strategy and woken for
+	// each block, so no threads are started or stopped per block.
+	class pool_strategy : public mining_strategy
+	{
+	public:
+		explicit pool_strategy(unsigned int num_threads, bool lanes)
+			: _pool(default_threads(num_threads)), _lanes(lanes)
+		{
+		}
+
+		const char *name() const noexcept override { return _lanes ? "simd" : "pool"; }
+
+		void mine(const mining_job &job, mining_outcome &outcome) override
+		{
+			outcome.size_workers(_pool.size());
+			_pool.run([&](unsigned int id, unsigned int num_threads)
+			{
+				pin_worker(job, id);
+				if (_lanes)
+				{
+					// Worker 0 tries 1-8, then 1 + 8n..., worker 1 tries 9-16...
+					// (spread out by nonce_spacing when sharing the space).
+					const uint64_t stride = static_cast<uint64_t>(num_threads) * SHA256_LANES * job.nonce_spacing;
+					search_stride_lanes(job, job.first_nonce + static_cast<uint64_t>(id) * SHA256_LANES * job.nonce_spacing, stride, outcome, id);
+				}
+				else
+				{
+					search_stride(job, job.first_nonce + id * job.nonce_spacing, num_threads * job.nonce_spacing, outcome, id);
+				}
+			});
+		}
+
+	private:
+		mining_pool _pool;
+		// Hash SHA256_LANES nonces per call with the multi-buffer engine.
+		bool _lanes;
+	};
+
+	// Like simd, but rather than a fixed stride each worker takes chunks
+	// of consecutive nonces from a nonce_scheduler, stealing from the
+	// others when it runs out.  Workers on faster cores end up searching
+	// more, so none waits on a slower one, which matters on hybrid CPUs
+	// and when SMT siblings share a core.
+	class steal_strategy : public mining_strategy
+	{
+	public:
+		explicit steal_strategy(unsigned int num_threads)
+			: _pool(default_threads(num_threads))
+		{
+		}
+
+		const char *name() const noexcept override { return "steal"; }
+
+		// Chunks are handed out in no fixed order, so no worker's
+		// progress bounds what has been searched.
+		bool resumable() const noexcept override { return false; }
+
+		void mine(const mining_job &job, mining_outcome &outcome) override
+		{
+			// Enough for every worker to have a few chunks in hand, so
+			// the early steals have something to split.
+			nonce_scheduler scheduler(_pool.size(), 64);
+			outcome.size_workers(_pool.size());
+			_pool.run([&](unsigned int id, unsigned int)
+			{
+				trace_scope scope("search");
+				pin_worker(job, id);
+				auto begin = chrono::steady_clock::now();
+				header_buffer lanes[SHA256_LANES];
+				const unsigned char *tails[SHA256_LANES];
+				size_t lengths[SHA256_LANES];
+				unsigned char digests[SHA256_LANES][SHA256::DIGEST_SIZE];
+				uint64_t attempts = 0;
+
+				while (!outcome.found.load(memory_order_relaxed) && !job.cancelled())
+				{
+					trace_scope batch("hash batch");
+					// Chunk c is nonces c * CANCEL_CHECK_INTERVAL onwards,
+					// counting in steps of nonce_spacing from first_nonce.
+					const uint64_t first = job.first_nonce + scheduler.next(id) * CANCEL_CHECK_INTERVAL * job.nonce_spacing;
+					for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+					{
+						lanes[lane].reset(first + lane * job.nonce_spacing, job.suffix);
+					}
+					for (uint64_t k = 0; k < CANCEL_CHECK_INTERVAL && !outcome.found.load(memory_order_relaxed); k += SHA256_LANES)
+					{
+						for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+						{
+							tails[lane] = lanes[lane].data();
+							lengths[lane] = lanes[lane].length();
+						}
+						sha256_multi(job.midstate, tails, lengths, digests);
+						attempts += SHA256_LANES;
+						for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+						{
+							if (has_leading_zero_nibbles(digests[lane], job.difficulty))
+							{
+								bool won = outcome.publish(lanes[lane].nonce(), digests[lane]);
+								record_worker(outcome, id, begin, attempts, won ? 0 : SHA256_LANES);
+								return;
+							}
+						}
+						for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+						{
+							lanes[lane].advance(SHA256_LANES * job.nonce_spacing);
+						}
+					}
+				}
+				record_worker(outcome, id, begin, attempts, attempts > 0 ? SHA256_LANES : 0);
+			});
+			for (unsigned int id = 0; id < _pool.size(); ++id)
+			{
+				outcome.workers[id].steals = scheduler.steals(id);
+			}
+		}
+
+	private:
+		mining_pool _pool;
+	};
+}
+
+unique_ptr<mining_strategy> make_strategy(const string &name, unsigned int num_threads)
+{
+	if (name == "serial")
+		return unique_ptr<mining_strategy>(new serial_strategy());
+	if (name == "threads")
+		return unique_ptr<mining_strategy>(new thread_strategy());
+	if (name == "openmp")
+		return unique_ptr<mining_strategy>(new openmp_strategy());
+	if (name == "openmp-cancel")
+		return unique_ptr<mining_strategy>(new openmp_cancel_strategy());
+	if (name == "pool")
+		return unique_ptr<mining_strategy>(new pool_strategy(num_threads, false));
+	if (name == "simd")
+		return unique_ptr<mining_strategy>(new pool_strategy(num_threads, true));
+	if (name == "steal")
+		return unique_ptr<mining_strategy>(new steal_strategy(num_threads));
+	return nullptr;
+}
+
+vector<string> strategy_names()
+{
+	return { "serial", "threads", "openmp", "openmp-cancel", "pool", "simd", "steal" };
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "sha256.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Everything a miner needs to search for one block's nonce.  The block
+// has already absorbed the header fields ahead of the nonce into the
+// midstate; each candidate is the nonce in decimal followed by suffix.
+struct mining_job
+{
+	SHA256 midstate;
+	std::string suffix;
+	uint32_t difficulty;
+	// Threads to search with; 0 means one per hardware thread.
+	// Strategies with a fixed pool of workers use their own size.
+	unsigned int num_threads;
+	// Logical CPUs the search threads are pinned to, if not empty.
+	std::vector<unsigned int> cpus;
+	// If not empty, worker i is pinned to worker_cpus[i] alone instead,
+	// wrapping round when there are more workers than entries.
+	std::vector<unsigned int> worker_cpus;
+	// The nonces searched are first_nonce, first_nonce + nonce_spacing,
+	// first_nonce + 2 * nonce_spacing..., so separate processes can
+	// each take a disjoint share of the nonce space.
+	uint64_t first_nonce = 1;
+	uint64_t nonce_spacing = 1;
+	// Set by the caller to abandon the block.  Search threads check it
+	// every few thousand nonces and stop without a result.
+	const std::atomic<bool> *cancel = nullptr;
+
+	inline bool cancelled() const noexcept { return cancel != nullptr && cancel->load(std::memory_order_relaxed); }
+};
+
+// What one search thread did for a block.  Each thread only writes its
+// own entry, and only once it stops, so the counters cost nothing while
+// hashing.  Entries are aligned to a cache line so neighbours' writes
+// never land on the same one (in a vector, that needs aligned new,
+// which C++14 builds only get from /Zc:alignedNew or -faligned-new).
+struct alignas(64) worker_counters
+{
+	// Hashes tried.
+	uint64_t attempts = 0;
+	// Of those, the batch still in flight when another thread won,
+	// plus any solution that lost the race to be published.
+	uint64_t wasted = 0;
+	// When the thread started and stopped searching.
+	std::chrono::steady_clock::time_point begin;
+	std::chrono::steady_clock::time_point end;
+	// Times the thread took over part of another's share of the nonces,
+	// for strategies that balance the work that way.
+	uint64_t steals = 0;
+	// The next nonce the thread will try, 0 until it starts.  Unlike
+	// the rest this is updated as it goes, every few thousand nonces,
+	// so a checkpoint can tell how far the search has got.
+	std::atomic<uint64_t> next_nonce{0};
+
+	worker_counters() = default;
+	worker_counters(const worker_counters &other) noexcept { *this = other; }
+	worker_counters& operator=(const worker_counters &other) noexcept
+	{
+		attempts = other.attempts;
+		wasted = other.wasted;
+		begin = other.begin;
+		end = other.end;
+		steals = other.steals;
+		next_nonce.store(other.next_nonce.load());
+		return *this;
+	}
+};
+static_assert(sizeof(worker_counters) == 64, "worker_counters should fill exactly one cache line");
+
+// Where the search threads report back.  The first to claim found
+// writes nonce and digest; everyone else stops at their next check.
+struct mining_outcome
+{
+	std::atomic<bool> found;
+	uint64_t nonce;
+	sha256_digest digest;
+	// When the winner published.
+	std::chrono::steady_clock::time_point solved;
+	// One entry per search thread, sized by the strategy with
+	// size_workers before any starts searching.  Strategies that don't
+	// size it just go unmeasured.
+	std::vector<worker_counters> workers;
+	// Set once workers has been sized, so a checkpoint taken from
+	// another thread never reads it mid-resize.
+	std::atomic<bool> workers_sized;
+
+	mining_outcome() : found(false), nonce(0), digest(), workers_sized(false) {}
+
+	// Returns true if this call was the one that published the result.
+	bool publish(uint64_t winning_nonce, const unsigned char *winning_digest) noexcept;
+
+	inline void size_workers(size_t count)
+	{
+		workers.resize(count);
+		workers_sized.store(true, std::memory_order_release);
+	}
+};
+
+// How mine_block searches the nonce space.  The strategies only differ
+// in how the work is spread over threads; they all share the search
+// loops below, so a fix to hashing lands in every one of them.
+class mining_strategy
+{
+public:
+	virtual ~mining_strategy() {}
+
+	// Short name used on the command line and in results files.
+	virtual const char *name() const noexcept = 0;
+
+	// Whether outcome.workers covers the whole search, so a checkpoint
+	// can be taken from it.
+	virtual bool resumable() const noexcept { return true; }
+
+	// Searches until a nonce meets the difficulty and fills in outcome,
+	// or until the job is cancelled, leaving outcome.found false.
+	virtual void mine(const mining_job &job, mining_outcome &outcome) = 0;
+};
+
+// Tries nonces first, first + stride, first + 2 * stride... one at a
+// time until any thread finds a solution or the job is cancelled.  What it did is recorded in
+// outcome.workers[worker], if there is such an entry.
+void search_stride(const mining_job &job, uint64_t first, uint64_t stride, mining_outcome &outcome, unsigned int worker = 0) noexcept;
+
+// Tries SHA256_LANES nonces at a time through the multi-buffer engine:
+// first, first + job.nonce_spacing... up to 8 of them, then the same
+// again from first + stride..., until any thread finds a solution.
+// stride should be a multiple of SHA256_LANES * job.nonce_spacing.
+void search_stride_lanes(const mining_job &job, uint64_t first, uint64_t stride, mining_outcome &outcome, unsigned int worker = 0) noexcept;
+
+// Creates a strategy by name: "serial", "threads", "openmp",
+// "openmp-cancel", "pool", "simd" or "steal".  num_threads sizes the pool-based strategies (0 for one per
+// hardware thread).  Returns nullptr for an unknown name.
+std::unique_ptr<mining_strategy> make_strategy(const std::string &name, unsigned int num_threads = 0);
+
+// All of the names make_strategy understands.
+std::vector<std::string> strategy_names();
+
+// A nonce such that every nonce of the job below it has been tried,
+// going by each worker's next_nonce.  Threads searching ahead of the
+// slowest don't count, so resuming from here repeats a little work
+// but never skips any.  Returns job.first_nonce until every worker has
+// started.
+uint64_t searched_up_to(const mining_job &job, const mining_outcome &outcome) noexcept;
@@ -0,0 +1,85 @@
+#include "nonce_scheduler.h"
+
+using namespace std;
+
+nonce_scheduler::nonce_scheduler(unsigned int num_workers, uint64_t span_chunks)
+	: _ranges(num_workers == 0 ? 1 : num_workers), _span_chunks(span_chunks == 0 ? 1 : span_chunks), _next_span(_ranges.size())
+{
+	for (size_t i = 0; i < _ranges.size(); ++i)
+	{
+		_ranges[i].begin.store(i * _span_chunks);
+		_ranges[i].end.store((i + 1) * _span_chunks);
+	}
+}
+
+uint64_t nonce_scheduler::next(unsigned int worker) noexcept
+{
+	range &own = _ranges[worker];
+	for (;;)
+	{
+		{
+			lock_guard<mutex> lock(own.lock);
+			uint64_t chunk = own.begin.load(memory_order_relaxed);
+			if (chunk < own.end.load(memory_order_relaxed))
+			{
+				own.begin.store(chunk + 1, memory_order_relaxed);
+				return chunk;
+			}
+		}
+		if (steal(worker))
+		{
+			continue;
+		}
+		// Nothing worth taking, so start on new ground.
+		uint64_t span = _next_span.fetch_add(1);
+		lock_guard<mutex> lock(own.lock);
+		own.end.store((span + 1) * _span_chunks, memory_order_relaxed);
+		own.begin.store(span * _span_chunks + 1, memory_order_relaxed);
+		return span * _span_chunks;
+	}
+}
+
+bool nonce_scheduler::steal(unsigned int thief) noexcept
+{
+	// Size up the others without locking; the victim's lock is only
+	// taken for the one that looks biggest.
+	size_t victim = _ranges.size();
+	uint64_t biggest = 1;
+	for (size_t i = 0; i < _ranges.size(); ++i)
+	{
+		uint64_t begin = _ranges[i].begin.load(memory_order_relaxed);
+		uint64_t end = _ranges[i].end.load(memory_order_relaxed);
+		if (i != thief && end > begin && end - begin > biggest)
+		{
+			victim = i;
+			biggest = end - begin;
+		}
+	}
+	if (victim == _ranges.size())
+	{
+		return false;
+	}
+
+	// The owner may have taken more since, so look again under its lock.
+	uint64_t begin;
+	uint64_t end;
+	{
+		range &from = _ranges[victim];
+		lock_guard<mutex> lock(from.lock);
+		begin = from.begin.load(memory_order_relaxed);
+		end = from.end.load(memory_order_relaxed);
+		if (end <= begin + 1)
+		{
+			return false;
+		}
+		begin += (end - begin) / 2;
+		from.end.store(begin, memory_order_relaxed);
+	}
+
+	range &own = _ranges[thief];
+	lock_guard<mutex> lock(own.lock);
+	own.begin.store(begin, memory_order_relaxed);
+	own.end.store(end, memory_order_relaxed);
+	own.steals.fetch_add(1, memory_order_relaxed);
+	return true;
+}
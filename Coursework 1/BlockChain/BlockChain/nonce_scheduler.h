@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Hands out an endless run of numbered chunks of nonce space to a fixed
+// set of workers.  Each worker owns a range of chunks and takes them off
+// the front.  One whose range runs dry steals the back half of the
+// biggest range left, so a fast core takes over work a slow one hasn't
+// reached yet rather than sitting idle; a fresh span of chunks is only
+// handed out once there is nothing worth stealing.  Every chunk is
+// handed out exactly once.
+class nonce_scheduler
+{
+public:
+	// Each worker starts with a span of span_chunks chunks.
+	nonce_scheduler(unsigned int num_workers, uint64_t span_chunks);
+
+	nonce_scheduler(const nonce_scheduler&) = delete;
+	nonce_scheduler& operator=(const nonce_scheduler&) = delete;
+
+	// The next chunk for worker to search.  Safe to call from every
+	// worker at once, as long as each passes its own id.
+	uint64_t next(unsigned int worker) noexcept;
+
+	// How many times worker has taken chunks from another.
+	inline uint64_t steals(unsigned int worker) const noexcept { return _ranges[worker].steals.load(); }
+
+private:
+	// Chunks [begin, end) not yet handed out.  Only changed under lock,
+	// but begin and end can be read without it to size up a victim.
+	struct range
+	{
+		std::mutex lock;
+		std::atomic<uint64_t> begin{0};
+		std::atomic<uint64_t> end{0};
+		// Only counted by the owner, when it steals.
+		std::atomic<uint64_t> steals{0};
+		// Keeps neighbouring workers' ranges off each other's cache line.
+		char _padding[64];
+	};
+
+	bool steal(unsigned int thief) noexcept;
+
+	std::vector<range> _ranges;
+	uint64_t _span_chunks;
+	// The next span never handed to anyone.
+	std::atomic<uint64_t> _next_span;
+};
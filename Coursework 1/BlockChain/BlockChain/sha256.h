@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+class SHA256
+{
+protected:
+    static const uint32_t sha256_k[];
+    static constexpr size_t SHA224_256_BLOCK_SIZE = (512/8);
+    void transform(const unsigned char *message, size_t block_nb);
+    size_t m_tot_len;
+    size_t m_len;
+    unsigned char m_block[2 * SHA224_256_BLOCK_SIZE];
+    uint32_t m_h[8];
+public:
+    void init();
+    void update(const unsigned char *message, size_t len);
+    void final(unsigned char *digest);
+    // Midstate support: resume from a context that has already absorbed
+    // a constant prefix, so the prefix's blocks are only compressed once.
+    void resume(const SHA256 &midstate) { *this = midstate; }
+    // Lays out the padded final blocks of (absorbed bytes + tail) in out
+    // without compressing them, so the multi-buffer engine can finish
+    // several messages at once.  Returns the number of 64 byte blocks
+    // written, or 0 if they would not fit in max_blocks.
+    size_t pad_final(const unsigned char *tail, size_t len, unsigned char *out, size_t max_blocks) const;
+    const uint32_t *chaining_value() const { return m_h; }
+    // Bytes absorbed but not yet compressed, and how many bytes have
+    // been compressed, for finishing a midstate somewhere else.
+    const unsigned char *pending() const { return m_block; }
+    size_t pending_length() const { return m_len; }
+    size_t compressed_length() const { return m_tot_len; }
+    static const uint32_t *round_constants() { return sha256_k; }
+    static constexpr size_t DIGEST_SIZE = (256/8);
+};
+
+// Raw 32 byte digest, most significant byte first.
+typedef std::array<uint8_t, SHA256::DIGEST_SIZE> sha256_digest;
+
+sha256_digest sha256_raw(const std::string &input);
+
+// Hex string version of the above.
+std::string sha256(const std::string &input);
+
+// Name of the compression backend picked at startup: "sha-ni" when the
+// CPU has the SHA extensions, otherwise "scalar".  Digests are identical.
+const char *sha256_backend() noexcept;
+// Formats a raw digest as 64 lowercase hex characters.
+std::string sha256_hex(const unsigned char *digest);
+// As above, writing the characters to out without allocating.
+void sha256_hex(const unsigned char *digest, char *out) noexcept;
+// Parses 64 hex characters back into a raw digest.  Returns false for
+// anything else, such as the genesis block's empty hash.
+bool sha256_from_hex(const std::string &hex, unsigned char *digest) noexcept;
+// True if the digest's hex form would start with at least n '0's,
+// checked on the raw words without formatting it.
+bool has_leading_zero_nibbles(const unsigned char *digest, uint32_t n) noexcept;
@@ -0,0 +1,227 @@
+#include "sha256_multi.h"
+#include "cpu_features.h"
+
+#include <cstring>
+
+#if defined(CPU_FEATURES_X86)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Tails longer than this are rare enough to just hash one at a time.
+static constexpr size_t MAX_TAIL_BLOCKS = 4;
+
+enum class engine { scalar, sse2, avx2 };
+
+static engine pick_engine() noexcept
+{
+    static const engine e = cpu_has_avx2() ? engine::avx2 : cpu_has_sse2() ? engine::sse2 : engine::scalar;
+    return e;
+}
+
+static inline uint32_t load_be32(const unsigned char *p) noexcept
+{
+    return (static_cast<uint32_t>(p[0]) << 24u) | (static_cast<uint32_t>(p[1]) << 16u)
+           | (static_cast<uint32_t>(p[2]) << 8u) | static_cast<uint32_t>(p[3]);
+}
+
+static inline void store_be32(uint32_t x, unsigned char *p) noexcept
+{
+    p[0] = static_cast<unsigned char>(x >> 24u);
+    p[1] = static_cast<unsigned char>(x >> 16u);
+    p[2] = static_cast<unsigned char>(x >> 8u);
+    p[3] = static_cast<unsigned char>(x);
+}
+
+#if defined(CPU_FEATURES_X86)
+
+// State and message words are stored word-major, one column per lane:
+// h[i][lane] and w[j][lane], so a row loads straight into a register.
+
+#define ROTR256(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+#define SHR256(x, n) _mm256_srli_epi32((x), (n))
+#define XOR256(a, b, c) _mm256_xor_si256(_mm256_xor_si256((a), (b)), (c))
+#define ADD256(a, b) _mm256_add_epi32((a), (b))
+
+CPU_TARGET("avx2")
+static void compress_avx2(uint32_t h[8][SHA256_LANES], const uint32_t m[16][SHA256_LANES])
+{
+    const uint32_t *k = SHA256::round_constants();
+    __m256i w[64];
+    for (size_t j = 0; j < 16; ++j)
+        w[j] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m[j]));
+    for (size_t j = 16; j < 64; ++j)
+    {
+        __m256i s0 = XOR256(ROTR256(w[j - 15], 7), ROTR256(w[j - 15], 18), SHR256(w[j - 15], 3));
+        __m256i s1 = XOR256(ROTR256(w[j - 2], 17), ROTR256(w[j - 2], 19), SHR256(w[j - 2], 10));
+        w[j] = ADD256(ADD256(s1, w[j - 7]), ADD256(s0, w[j - 16]));
+    }
+
+    __m256i wv[8];
+    for (size_t i = 0; i < 8; ++i)
+        wv[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h[i]));
+    for (size_t j = 0; j < 64; ++j)
+    {
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(wv[4], wv[5]), _mm256_andnot_si256(wv[4], wv[6]));
+        __m256i maj = XOR256(_mm256_and_si256(wv[0], wv[1]), _mm256_and_si256(wv[0], wv[2]), _mm256_and_si256(wv[1], wv[2]));
+        __m256i f1 = XOR256(ROTR256(wv[4], 6), ROTR256(wv[4], 11), ROTR256(wv[4], 25));
+        __m256i f0 = XOR256(ROTR256(wv[0], 2), ROTR256(wv[0], 13), ROTR256(wv[0], 22));
+        __m256i t1 = ADD256(ADD256(wv[7], f1), ADD256(ch, ADD256(_mm256_set1_epi32(static_cast<int>(k[j])), w[j])));
+        __m256i t2 = ADD256(f0, maj);
+        wv[7] = wv[6];
+        wv[6] = wv[5];
+        wv[5] = wv[4];
+        wv[4] = ADD256(wv[3], t1);
+        wv[3] = wv[2];
+        wv[2] = wv[1];
+        wv[1] = wv[0];
+        wv[0] = ADD256(t1, t2);
+    }
+    for (size_t i = 0; i < 8; ++i)
+    {
+        __m256i *row = reinterpret_cast<__m256i*>(h[i]);
+        _mm256_storeu_si256(row, ADD256(_mm256_loadu_si256(row), wv[i]));
+    }
+}
+
+#define ROTR128(x, n) _mm_or_si128(_mm_srli_epi32((x), (n)), _mm_slli_epi32((x), 32 - (n)))
+#define SHR128(x, n) _mm_srli_epi32((x), (n))
+#define XOR128(a, b, c) _mm_xor_si128(_mm_xor_si128((a), (b)), (c))
+#define ADD128(a, b) _mm_add_epi32((a), (b))
+
+// Compresses the four lanes starting at column first.
+CPU_TARGET("sse2")
+static void compress_sse2(uint32_t h[8][SHA256_LANES], const uint32_t m[16][SHA256_LANES], size_t first)
+{
+    const uint32_t *k = SHA256::round_constants();
+    __m128i w[64];
+    for (size_t j = 0; j < 16; ++j)
+        w[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m[j][first]));
+    for (size_t j = 16; j < 64; ++j)
+    {
+        __m128i s0 = XOR128(ROTR128(w[j - 15], 7), ROTR128(w[j - 15], 18), SHR128(w[j - 15], 3));
+        __m128i s1 = XOR128(ROTR128(w[j - 2], 17), ROTR128(w[j - 2], 19), SHR128(w[j - 2], 10));
+        w[j] = ADD128(ADD128(s1, w[j - 7]), ADD128(s0, w[j - 16]));
+    }
+
+    __m128i wv[8];
+    for (size_t i = 0; i < 8; ++i)
+        wv[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&h[i][first]));
+    for (size_t j = 0; j < 64; ++j)
+    {
+        __m128i ch = _mm_xor_si128(_mm_and_si128(wv[4], wv[5]), _mm_andnot_si128(wv[4], wv[6]));
+        __m128i maj = XOR128(_mm_and_si128(wv[0], wv[1]), _mm_and_si128(wv[0], wv[2]), _mm_and_si128(wv[1], wv[2]));
+        __m128i f1 = XOR128(ROTR128(wv[4], 6), ROTR128(wv[4], 11), ROTR128(wv[4], 25));
+        __m128i f0 = XOR128(ROTR128(wv[0], 2), ROTR128(wv[0], 13), ROTR128(wv[0], 22));
+        __m128i t1 = ADD128(ADD128(wv[7], f1), ADD128(ch, ADD128(_mm_set1_epi32(static_cast<int>(k[j])), w[j])));
+        __m128i t2 = ADD128(f0, maj);
+        wv[7] = wv[6];
+        wv[6] = wv[5];
+        wv[5] = wv[4];
+        wv[4] = ADD128(wv[3], t1);
+        wv[3] = wv[2];
+        wv[2] = wv[1];
+        wv[1] = wv[0];
+        wv[0] = ADD128(t1, t2);
+    }
+    for (size_t i = 0; i < 8; ++i)
+    {
+        __m128i *row = reinterpret_cast<__m128i*>(&h[i][first]);
+        _mm_storeu_si128(row, ADD128(_mm_loadu_si128(row), wv[i]));
+    }
+}
+
+#endif
+
+static void sha256_multi_scalar(const SHA256 &midstate, const unsigned char *const *tails, const size_t *lengths, unsigned char (*digests)[SHA256::DIGEST_SIZE])
+{
+    for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+    {
+        SHA256 ctx;
+        ctx.resume(midstate);
+        ctx.update(tails[lane], lengths[lane]);
+        ctx.final(digests[lane]);
+    }
+}
+
+void sha256_multi(const SHA256 &midstate, const string *tails, unsigned char (*digests)[SHA256::DIGEST_SIZE])
+{
+    const unsigned char *data[SHA256_LANES];
+    size_t lengths[SHA256_LANES];
+    for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+    {
+        data[lane] = reinterpret_cast<const unsigned char*>(tails[lane].c_str());
+        lengths[lane] = tails[lane].length();
+    }
+    sha256_multi(midstate, data, lengths, digests);
+}
+
+void sha256_multi(const SHA256 &midstate, const unsigned char *const *tails, const size_t *lengths, unsigned char (*digests)[SHA256::DIGEST_SIZE])
+{
+    engine e = pick_engine();
+    if (e == engine::scalar)
+    {
+        sha256_multi_scalar(midstate, tails, lengths, digests);
+        return;
+    }
+
+    // Pad every lane's tail.  The lanes have to agree on how many
+    // blocks are left; when a nonce gains a digit part way through
+    // a batch they may not, so hash that batch one at a time.
+    unsigned char blocks[SHA256_LANES][MAX_TAIL_BLOCKS * 64];
+    size_t block_nb = 0;
+    for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+    {
+        size_t n = midstate.pad_final(tails[lane], lengths[lane], blocks[lane], MAX_TAIL_BLOCKS);
+        if (n == 0 || (lane > 0 && n != block_nb))
+        {
+            sha256_multi_scalar(midstate, tails, lengths, digests);
+            return;
+        }
+        block_nb = n;
+    }
+
+    uint32_t h[8][SHA256_LANES];
+    const uint32_t *start = midstate.chaining_value();
+    for (size_t i = 0; i < 8; ++i)
+        for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+            h[i][lane] = start[i];
+
+    for (size_t b = 0; b < block_nb; ++b)
+    {
+        uint32_t m[16][SHA256_LANES];
+        for (size_t j = 0; j < 16; ++j)
+            for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+                m[j][lane] = load_be32(&blocks[lane][(b << 6u) + (j << 2u)]);
+
+#if defined(CPU_FEATURES_X86)
+        if (e == engine::avx2)
+        {
+            compress_avx2(h, m);
+        }
+        else
+        {
+            compress_sse2(h, m, 0);
+            compress_sse2(h, m, 4);
+        }
+#endif
+    }
+
+    for (size_t lane = 0; lane < SHA256_LANES; ++lane)
+        for (size_t i = 0; i < 8; ++i)
+            store_be32(h[i][lane], &digests[lane][i << 2u]);
+}
+
+const char *sha256_multi_engine() noexcept
+{
+    switch (pick_engine())
+    {
+    case engine::avx2:
+        return "avx2";
+    case engine::sse2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
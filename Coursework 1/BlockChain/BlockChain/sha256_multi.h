@@ -0,0 +1,21 @@
+#pragma once
+
+#include "sha256.h"
+
+#include <string>
+
+// Number of messages finished by one call to sha256_multi.
+constexpr size_t SHA256_LANES = 8;
+
+// Finishes SHA256_LANES messages that share an already absorbed prefix
+// (the midstate) and differ only in their tails.  The 64 rounds run for
+// every lane at once: 8 lanes in one AVX2 register, or two passes of 4
+// lanes with SSE2.  Machines with neither fall back to scalar hashing.
+void sha256_multi(const SHA256 &midstate, const std::string *tails, unsigned char (*digests)[SHA256::DIGEST_SIZE]);
+// As above, with each tail given as a pointer and length.  Nothing is
+// allocated, so it is safe to call from an allocation-free mining loop.
+void sha256_multi(const SHA256 &midstate, const unsigned char *const *tails, const size_t *lengths, unsigned char (*digests)[SHA256::DIGEST_SIZE]);
+
+// Name of the engine sha256_multi uses on this machine:
+// "avx2", "sse2" or "scalar".
+const char *sha256_multi_engine() noexcept;
@@ -0,0 +1,219 @@
+#include "trace.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace
+{
+	// Events kept per ring: at one per batch of a few thousand hashes,
+	// about a minute of mining.
+	const size_t RING_CAPACITY = 1 << 16;
+
+	struct trace_event
+	{
+		const char *name;
+		// Nanoseconds since tracing started.
+		int64_t begin;
+		int64_t duration;
+		unsigned int tid;
+	};
+
+	// Only the thread holding a ring records into it, so it needs no
+	// lock.  A thread's ring passes to a new thread once it exits, so
+	// starting threads per block doesn't mean a ring per block.
+	struct thread_ring
+	{
+		// Grown as events arrive, up to RING_CAPACITY.
+		vector<trace_event> events;
+		// Events ever recorded; the latest RING_CAPACITY are kept.
+		uint64_t written = 0;
+	};
+
+	atomic<bool> enabled(false);
+	// Set before enabled, and never changed after.
+	steady_clock::time_point epoch;
+	string output_path;
+
+	// Every ring, kept after its threads exit so their events still get
+	// written, and the rings no thread holds right now.
+	mutex rings_mutex;
+	vector<unique_ptr<thread_ring>> rings;
+	vector<thread_ring*> free_rings;
+	// Thread names, by tid - 1.
+	vector<string> thread_names;
+
+	// The calling thread's ring and id, handed back when the thread exits.
+	struct ring_lease
+	{
+		thread_ring *ring = nullptr;
+		unsigned int tid = 0;
+
+		~ring_lease()
+		{
+			if (ring != nullptr)
+			{
+				lock_guard<mutex> lock(rings_mutex);
+				free_rings.push_back(ring);
+			}
+		}
+	};
+	thread_local ring_lease current;
+
+	ring_lease& current_lease()
+	{
+		if (current.ring == nullptr)
+		{
+			lock_guard<mutex> lock(rings_mutex);
+			if (free_rings.empty())
+			{
+				rings.emplace_back(new thread_ring());
+				current.ring = rings.back().get();
+			}
+			else
+			{
+				current.ring = free_rings.back();
+				free_rings.pop_back();
+			}
+			thread_names.emplace_back();
+			current.tid = static_cast<unsigned int>(thread_names.size());
+		}
+		return current;
+	}
+
+	void write_at_exit()
+	{
+		trace_write(output_path);
+	}
+
+	// Thread names are ours, but keep the JSON valid whatever they hold.
+	string escape(const string &s)
+	{
+		string out;
+		for (char c : s)
+		{
+			if (c == '"' || c == '\\')
+				out += '\\';
+			out += c;
+		}
+		return out;
+	}
+}
+
+void trace_to_file(const string &path)
+{
+	if (enabled.load())
+	{
+		return;
+	}
+	output_path = path;
+	epoch = steady_clock::now();
+	enabled.store(true);
+	atexit(write_at_exit);
+}
+
+bool tracing() noexcept
+{
+	return enabled.load(memory_order_relaxed);
+}
+
+bool trace_write(const string &path)
+{
+	ofstream out(path, ofstream::out);
+	if (!out)
+	{
+		return false;
+	}
+	out.setf(ios::fixed);
+	out.precision(3);
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	bool first = true;
+	uint64_t dropped = 0;
+	lock_guard<mutex> lock(rings_mutex);
+	for (size_t i = 0; i < thread_names.size(); ++i)
+	{
+		if (!thread_names[i].empty())
+		{
+			out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << i + 1
+				<< ", \"args\": {\"name\": \"" << escape(thread_names[i]) << "\"}}";
+			first = false;
+		}
+	}
+	for (auto &ring : rings)
+	{
+		// Oldest first, starting after whatever was overwritten.
+		uint64_t begin = ring->written > RING_CAPACITY ? ring->written - RING_CAPACITY : 0;
+		dropped += begin;
+		for (uint64_t i = begin; i < ring->written; ++i)
+		{
+			const trace_event &e = ring->events[i % RING_CAPACITY];
+			out << (first ? "" : ",\n") << "{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.tid
+				<< ", \"ts\": " << e.begin / 1000.0 << ", \"dur\": " << e.duration / 1000.0 << "}";
+			first = false;
+		}
+	}
+	out << "\n], \"otherData\": {\"dropped_events\": " << dropped << "}}\n";
+	return static_cast<bool>(out);
+}
+
+void trace_thread_name(const string &name)
+{
+	if (tracing())
+	{
+		unsigned int tid = current_lease().tid;
+		lock_guard<mutex> lock(rings_mutex);
+		thread_names[tid - 1] = name;
+	}
+}
+
+void trace_span(const char *name, steady_clock::time_point begin) noexcept
+{
+	if (!tracing())
+	{
+		return;
+	}
+	auto end = steady_clock::now();
+	try
+	{
+		ring_lease &lease = current_lease();
+		thread_ring &ring = *lease.ring;
+		trace_event e;
+		e.name = name;
+		e.begin = duration_cast<nanoseconds>(begin - epoch).count();
+		e.duration = duration_cast<nanoseconds>(end - begin).count();
+		e.tid = lease.tid;
+		if (ring.events.size() < RING_CAPACITY)
+			ring.events.push_back(e);
+		else
+			ring.events[ring.written % RING_CAPACITY] = e;
+		++ring.written;
+	}
+	catch (const exception &)
+	{
+		// Couldn't grow this thread's ring; go without the event.
+	}
+}
+
+trace_scope::trace_scope(const char *name) noexcept
+	: _name(tracing() ? name : nullptr)
+{
+	if (_name != nullptr)
+	{
+		_begin = steady_clock::now();
+	}
+}
+
+trace_scope::~trace_scope()
+{
+	if (_name != nullptr)
+	{
+		trace_span(_name, _begin);
+	}
+}
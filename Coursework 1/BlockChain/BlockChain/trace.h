@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// A lightweight timeline of what each thread was doing, written out in
+// Chrome's trace event format for chrome://tracing or Perfetto.  Each
+// thread records into a ring buffer of its own, so recording takes no
+// locks.  A ring grows as it fills, and once full its oldest events are
+// overwritten; when its thread exits it is handed on to the next thread
+// to start, so threads started per block share a few rings.  While
+// tracing is off, every call returns after one look at a flag.
+
+// Starts tracing.  The trace is written to path when the process exits.
+void trace_to_file(const std::string &path);
+
+// Whether events are being recorded.
+bool tracing() noexcept;
+
+// Writes every thread's events so far to path.  Only call it once
+// the threads being traced have stopped recording.
+bool trace_write(const std::string &path);
+
+// Names the calling thread on the timeline.
+void trace_thread_name(const std::string &name);
+
+// Records a span on the calling thread from begin until now.  name must
+// last as long as the trace, such as a string literal.
+void trace_span(const char *name, std::chrono::steady_clock::time_point begin) noexcept;
+
+// Records a span covering its own lifetime.
+class trace_scope
+{
+public:
+	explicit trace_scope(const char *name) noexcept;
+	~trace_scope();
+
+	trace_scope(const trace_scope&) = delete;
+	trace_scope& operator=(const trace_scope&) = delete;
+
+private:
+	// Null if tracing was off when the scope opened.
+	const char *_name;
+	std::chrono::steady_clock::time_point _begin;
+};
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include <mpi.h>
+#include "block_chain.h"
+#include "affinity.h"
+#include "mpi_strategy.h"
+
+using namespace std;
+using namespace chrono;
+
+// Run with mpirun -np N.  Every rank mines a share of each block's
+// nonces; rank 0 keeps the chain and writes the results.
+int main(int argc, char **argv)
+{
+	// Only the main thread of each rank talks to MPI.  The mining
+	// threads just hash, and are stopped through the outcome flag.
+	int provided;
+	auto result = MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+	if (result != MPI_SUCCESS)
+	{
+		cout << "ERROR - initialising MPI" << endl;
+		MPI_Abort(MPI_COMM_WORLD, result);
+		return -1;
+	}
+
+	int my_rank, num_procs;
+	MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+	// Passing --strategy NAME picks how each rank searches its share.
+	string strategy = "pool";
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (string(argv[i]) == "--strategy")
+			strategy = argv[++i];
+	}
+	if (!make_strategy(strategy))
+	{
+		if (my_rank == 0)
+			cout << "Unknown strategy " << strategy << endl;
+		MPI_Finalize();
+		return 1;
+	}
+
+	// Ranks on the same host each get their own share of the cores.
+	vector<unsigned int> cpus = cpu_subset(static_cast<unsigned int>(my_rank), static_cast<unsigned int>(num_procs));
+	unsigned int num_threads = static_cast<unsigned int>(cpus.size());
+	auto local = make_strategy(strategy, num_threads);
+
+	if (my_rank != 0)
+	{
+		mpi_mine_worker(*local, num_threads, cpus);
+		MPI_Finalize();
+		return 0;
+	}
+
+	{
+		block_chain bchain(unique_ptr<mining_strategy>(new mpi_strategy(move(local))));
+		bchain.num_threads = num_threads;
+		bchain.cpus = cpus;
+		cout << "Mining across " << num_procs << " processes, " << num_threads << " threads each, local strategy: " << strategy << endl;
+
+		// Open a file in the root folder,
+		bchain.results.open("MPI.csv", ofstream::out);
+		// And add the headings for average block time, difficulty and processes.
+		bchain.results << "Average Block Time" << "," << "Difficulty" << "," << "Processes" << endl;
+
+		for (uint32_t difficulty = 1; difficulty < 6; difficulty++)
+		{
+			auto start = system_clock::now();
+			for (uint32_t i = 1; i < 100u; ++i)
+			{
+				bchain.add_block(block(i, string("Block ") + to_string(i) + string(" Data")), difficulty);
+			}
+			auto end = system_clock::now();
+			duration<double> diff = end - start;
+			bchain.results << diff.count() << "," << difficulty << "," << num_procs << endl;
+		}
+
+		bchain.results.close();
+	}
+
+	mpi_release_workers();
+	MPI_Finalize();
+
+	return 0;
+}
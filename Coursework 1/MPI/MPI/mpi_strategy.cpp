@@ -0,0 +1,207 @@
+#include "mpi_strategy.h"
+#include "header_buffer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <mpi.h>
+
+using namespace std;
+
+namespace
+{
+	// Tag for the message a winning rank sends every other rank.
+	const int TAG_FOUND = 1;
+
+	// How long a rank's main thread waits between checks for a winner.
+	// This bounds how much hashing a rank wastes after another has won.
+	const chrono::microseconds POLL_INTERVAL(100);
+
+	enum command : uint32_t
+	{
+		MINE,
+		STOP
+	};
+
+	// Broadcast ahead of each job, so the workers know what follows.
+	struct job_header
+	{
+		uint32_t command;
+		uint32_t difficulty;
+		uint32_t suffix_length;
+	};
+
+	// Every rank runs the same binary on the same host, so the midstate
+	// can go over the wire as it sits in memory.
+	static_assert(is_trivially_copyable<SHA256>::value, "SHA256 midstates are broadcast as raw bytes");
+
+	void broadcast_header(job_header &header)
+	{
+		MPI_Bcast(&header, sizeof(header), MPI_BYTE, 0, MPI_COMM_WORLD);
+	}
+
+	// Searches this rank's share of the nonces until any rank wins, then
+	// agrees the winner with everyone else.  Every rank calls this once
+	// per block.  Returns the winning nonce, the lowest if several ranks
+	// found one at the same time.
+	uint64_t search_share(mining_strategy &local, mining_job &job, mining_outcome &outcome)
+	{
+		int my_rank, num_procs;
+		MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+		MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+		job.first_nonce = static_cast<uint64_t>(my_rank) + 1;
+		job.nonce_spacing = static_cast<uint64_t>(num_procs);
+
+		// Listen for another rank's win before starting, so it can't be missed.
+		uint64_t remote_nonce = 0;
+		MPI_Request found_request;
+		MPI_Irecv(&remote_nonce, 1, MPI_UINT64_T, MPI_ANY_SOURCE, TAG_FOUND, MPI_COMM_WORLD, &found_request);
+
+		// The local threads hash in the background while this
+		// thread, the only one that talks to MPI, keeps watch.
+		thread miner([&]
+		{
+			local.mine(job, outcome);
+		});
+
+		bool won = false;
+		int received = 0;
+		while (true)
+		{
+			// Only the local threads set found until we've heard from another rank.
+			if (outcome.found.load())
+			{
+				won = true;
+				break;
+			}
+			int done = 0;
+			MPI_Test(&found_request, &done, MPI_STATUS_IGNORE);
+			if (done)
+			{
+				received = 1;
+				// Stop the local threads, unless one of them beat us to it.
+				bool expected = false;
+				won = !outcome.found.compare_exchange_strong(expected, true);
+				break;
+			}
+			this_thread::sleep_for(POLL_INTERVAL);
+		}
+		miner.join();
+
+		// Tell everyone else to stop.
+		vector<MPI_Request> sends;
+		uint64_t local_nonce = won ? outcome.nonce : UINT64_MAX;
+		if (won)
+		{
+			for (int r = 0; r < num_procs; ++r)
+			{
+				if (r == my_rank)
+					continue;
+				sends.push_back(MPI_Request());
+				MPI_Isend(&local_nonce, 1, MPI_UINT64_T, r, TAG_FOUND, MPI_COMM_WORLD, &sends.back());
+			}
+		}
+
+		// Several ranks can win at once, so agree on the lowest nonce
+		// and find out how many notices are on their way to each rank.
+		uint64_t winning_nonce;
+		MPI_Allreduce(&local_nonce, &winning_nonce, 1, MPI_UINT64_T, MPI_MIN, MPI_COMM_WORLD);
+		int winners = won ? 1 : 0;
+		int total_winners;
+		MPI_Allreduce(&winners, &total_winners, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+		// Collect every notice sent to this rank, so none of them is
+		// mistaken for a win on the next block.
+		int expected = total_winners - winners;
+		if (received == 0)
+		{
+			if (expected > 0)
+			{
+				MPI_Wait(&found_request, MPI_STATUS_IGNORE);
+				received = 1;
+			}
+			else
+			{
+				MPI_Cancel(&found_request);
+				MPI_Wait(&found_request, MPI_STATUS_IGNORE);
+			}
+		}
+		for (int i = received; i < expected; ++i)
+		{
+			MPI_Recv(&remote_nonce, 1, MPI_UINT64_T, MPI_ANY_SOURCE, TAG_FOUND, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		}
+		if (!sends.empty())
+		{
+			MPI_Waitall(static_cast<int>(sends.size()), sends.data(), MPI_STATUSES_IGNORE);
+		}
+
+		return winning_nonce;
+	}
+}
+
+mpi_strategy::mpi_strategy(unique_ptr<mining_strategy> local)
+	: _local(move(local))
+{
+}
+
+void mpi_strategy::mine(const mining_job &job, mining_outcome &outcome)
+{
+	// Send the job out to the workers.
+	job_header header = { MINE, job.difficulty, static_cast<uint32_t>(job.suffix.length()) };
+	broadcast_header(header);
+	MPI_Bcast(const_cast<SHA256*>(&job.midstate), sizeof(SHA256), MPI_BYTE, 0, MPI_COMM_WORLD);
+	if (header.suffix_length > 0)
+	{
+		MPI_Bcast(const_cast<char*>(job.suffix.data()), static_cast<int>(header.suffix_length), MPI_CHAR, 0, MPI_COMM_WORLD);
+	}
+
+	mining_job share = job;
+	// Every rank has to agree on the winner, so the other ranks would
+	// never hear about it; a block is always mined to the end.
+	share.cancel = nullptr;
+	uint64_t nonce = search_share(*_local, share, outcome);
+
+	// The winner may be another rank's, so finish its digest here
+	// rather than sending it around as well.
+	header_buffer tail;
+	tail.reset(nonce, job.suffix);
+	SHA256 ctx;
+	ctx.resume(job.midstate);
+	ctx.update(tail.data(), tail.length());
+	ctx.final(outcome.digest.data());
+	outcome.nonce = nonce;
+}
+
+void mpi_mine_worker(mining_strategy &local, unsigned int num_threads, const vector<unsigned int> &cpus)
+{
+	while (true)
+	{
+		job_header header;
+		broadcast_header(header);
+		if (header.command == STOP)
+		{
+			return;
+		}
+
+		mining_job job;
+		job.difficulty = header.difficulty;
+		job.num_threads = num_threads;
+		job.cpus = cpus;
+		MPI_Bcast(&job.midstate, sizeof(SHA256), MPI_BYTE, 0, MPI_COMM_WORLD);
+		job.suffix.resize(header.suffix_length);
+		if (header.suffix_length > 0)
+		{
+			MPI_Bcast(&job.suffix[0], static_cast<int>(header.suffix_length), MPI_CHAR, 0, MPI_COMM_WORLD);
+		}
+
+		mining_outcome outcome;
+		search_share(local, job, outcome);
+	}
+}
+
+void mpi_release_workers()
+{
+	job_header header = { STOP, 0, 0 };
+	broadcast_header(header);
+}
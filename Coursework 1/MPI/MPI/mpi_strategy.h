@@ -0,0 +1,40 @@
+#pragma once
+
+#include "mining_strategy.h"
+
+#include <memory>
+#include <vector>
+
+// Spreads each block's nonce search over every rank in MPI_COMM_WORLD.
+// Rank 0 mines through this strategy as usual and broadcasts each job;
+// every other rank waits in mpi_mine_worker.  Rank r of n searches
+// nonces r + 1, r + 1 + n... with its own local strategy, so the
+// ranks never try the same nonce twice.
+//
+// The first rank to find a solution sends it to the others without
+// blocking.  Each rank's main thread polls for that message while its
+// local threads hash, so a rank stops within one poll interval of
+// hashing once another has won.
+class mpi_strategy : public mining_strategy
+{
+private:
+	std::unique_ptr<mining_strategy> _local;
+
+public:
+	explicit mpi_strategy(std::unique_ptr<mining_strategy> local);
+
+	const char *name() const noexcept override { return "mpi"; }
+	// Rank 0 only sees its own share of the nonces.
+	bool resumable() const noexcept override { return false; }
+
+	// Must be called on rank 0 only.
+	void mine(const mining_job &job, mining_outcome &outcome) override;
+};
+
+// Run by every rank other than 0: searches its share of each block rank
+// 0 broadcasts, using local on num_threads threads pinned to cpus.
+// Returns once rank 0 calls mpi_release_workers.
+void mpi_mine_worker(mining_strategy &local, unsigned int num_threads, const std::vector<unsigned int> &cpus);
+
+// Called on rank 0 once it has finished mining, before MPI_Finalize.
+void mpi_release_workers();
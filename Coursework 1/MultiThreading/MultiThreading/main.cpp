@@ -1,33 +1,122 @@
 #include <chrono>
 #include <fstream>
+#include <iostream>
+#include <string>
+#include <future>
+#include <vector>
 #include "block_chain.h"
+#include "trace.h"
 
 using namespace std;
 using namespace chrono;
 
-int main()
+int main(int argc, char **argv)
 {
-	block_chain bchain;
+	// Defaults to the persistent worker pool; pass --strategy NAME
+	// to mine with any of the other strategies instead.
+	string strategy = "pool";
+	// Pass --chain-file PATH to keep the chain on disk and resume it.
+	string chain_path;
+	// Pass --async to queue blocks with add_block_async, so the next
+	// block's data is built while the one before it is being mined.
+	bool async = false;
+	// Pass --affinity POLICY (compact, scatter or physical) to pin each
+	// mining thread to a CPU of its own.
+	affinity_policy affinity = affinity_policy::none;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (string(argv[i]) == "--strategy" && i + 1 < argc)
+			strategy = argv[++i];
+		else if (string(argv[i]) == "--chain-file" && i + 1 < argc)
+			chain_path = argv[++i];
+		else if (string(argv[i]) == "--async")
+			async = true;
+		// Pass --trace PATH to write a Chrome trace of the run on exit.
+		else if (string(argv[i]) == "--trace" && i + 1 < argc)
+			trace_to_file(argv[++i]);
+		else if (string(argv[i]) == "--affinity" && i + 1 < argc)
+		{
+			if (!parse_affinity_policy(argv[++i], affinity))
+			{
+				cout << "Unknown affinity policy " << argv[i] << endl;
+				return 1;
+			}
+		}
+	}
+	auto miner = make_strategy(strategy);
+	if (!miner)
+	{
+		cout << "Unknown strategy " << strategy << ", expected one of:";
+		for (auto &name : strategy_names())
+			cout << " " << name;
+		cout << endl;
+		return 1;
+	}
+
+	block_chain bchain(move(miner));
+	bchain.affinity = affinity;
+	// Blocks already in the chain file don't need mining again.
+	size_t resume_from = 0;
+	if (!chain_path.empty())
+	{
+		auto start = system_clock::now();
+		if (!bchain.open(chain_path))
+		{
+			cout << "Could not open chain file " << chain_path << endl;
+			return 1;
+		}
+		duration<double> diff = system_clock::now() - start;
+		resume_from = bchain.size() - 1;
+		cout << "Loaded " << bchain.size() << " blocks from " << chain_path << " in " << diff.count() << " seconds" << endl;
+
+		// Don't build on top of a chain that has been tampered with.
+		start = system_clock::now();
+		size_t invalid = bchain.validate();
+		diff = system_clock::now() - start;
+		if (invalid != bchain.size())
+		{
+			cout << "Chain file " << chain_path << " is invalid from block " << invalid << endl;
+			return 1;
+		}
+		cout << "Validated in " << diff.count() << " seconds" << endl;
+	}
+
 	// Open a file in the root folder,
 	bchain.results.open("MultiThreading.csv", ofstream::out);
 	// And add the headings for average block time and difficulty.
 	bchain.results << "Average Block Time" << "," << "Difficulty" << endl;
 
 	// Cycle through multiple difficulties on one run, rather than repeated runs.
+	size_t block_count = 0;
 	for (uint32_t difficulty = 1; difficulty < 6; difficulty++)
 	{
 		auto start = system_clock::now();
+		vector<future<block_ref>> mined;
 		for (uint32_t i = 1; i < 100u; ++i)
 		{
-			bchain.add_block(block(i, string("Block ") + to_string(i) + string(" Data")), difficulty);
+			if (block_count++ < resume_from)
+				continue;
+			if (async)
+				mined.push_back(bchain.add_block_async(block(i, string("Block ") + to_string(i) + string(" Data")), difficulty));
+			else
+				bchain.add_block(block(i, string("Block ") + to_string(i) + string(" Data")), difficulty);
 		}
+		for (auto &f : mined)
+			f.wait();
 		auto end = system_clock::now();
 
 		duration<double> diff = end - start;
-		bchain.results << diff.count() << "," << difficulty << endl;
+		// Difficulties finished by an earlier run have nothing to report.
+		if (block_count > resume_from)
+			bchain.results << diff.count() << "," << difficulty << endl;
 	}
 
 	bchain.results.close();
 
+	// Block times per difficulty, with each bucket's attempts and idling,
+	// to tell unlucky blocks from ones that scaled badly.
+	ofstream histograms("MultiThreading_histogram.csv", ofstream::out);
+	bchain.stats().write_histograms(histograms);
+
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include "opencl_strategy.h"
+#include "block_chain.h"
+
+using namespace std;
+using namespace chrono;
+
+int main(int argc, char **argv)
+{
+	// Passing --device cpu|gpu|all picks the OpenCL device type.  CPU is
+	// the default, so the kernel can be compared with the threaded
+	// miners on the same cores (POCL provides one on Linux).
+	string device = "cpu";
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (string(argv[i]) == "--device")
+			device = argv[++i];
+	}
+	cl_device_type type = CL_DEVICE_TYPE_ALL;
+	if (device == "cpu")
+		type = CL_DEVICE_TYPE_CPU;
+	else if (device == "gpu")
+		type = CL_DEVICE_TYPE_GPU;
+
+	try
+	{
+		unique_ptr<opencl_strategy> miner(new opencl_strategy(type));
+		cout << "OpenCL device: " << miner->device_name() << endl;
+
+		block_chain bchain(move(miner));
+		// Open a file in the root folder,
+		bchain.results.open("OpenCL.csv", ofstream::out);
+		// And add the headings for average block time and difficulty.
+		bchain.results << "Average Block Time" << "," << "Difficulty" << endl;
+
+		for (uint32_t difficulty = 1; difficulty < 6; difficulty++)
+		{
+			auto start = system_clock::now();
+			for (uint32_t i = 1; i < 100u; ++i)
+			{
+				bchain.add_block(block(i, string("Block ") + to_string(i) + string(" Data")), difficulty);
+			}
+			auto end = system_clock::now();
+			duration<double> diff = end - start;
+			bchain.results << diff.count() << "," << difficulty << endl;
+		}
+
+		bchain.results.close();
+	}
+	catch (cl::Error error)
+	{
+		cout << error.what() << "(" << error.err() << ")" << endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,153 @@
+#include "opencl_strategy.h"
+#include "header_buffer.h"
+#include "trace.h"
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+using namespace cl;
+
+// Must match MAX_BLOCKS in sha256_mine.cl.
+static const size_t MAX_MESSAGE_BYTES = 4 * 64;
+// The most decimal digits a nonce can have.
+static const size_t MAX_NONCE_DIGITS = 20;
+// The 0x80 byte and 64 bit length that end the padding.
+static const size_t PADDING_BYTES = 9;
+// The first batch of each block.
+static const size_t FIRST_BATCH = 4096;
+
+opencl_strategy::opencl_strategy(cl_device_type type, const string &kernel_path, size_t max_batch)
+	: _max_batch(max_batch)
+{
+	// Take the first device of the right type on any platform.
+	vector<Platform> platforms;
+	Platform::get(&platforms);
+	vector<Device> devices;
+	for (auto &p : platforms)
+	{
+		try
+		{
+			p.getDevices(type, &devices);
+		}
+		catch (const Error &)
+		{
+			// This platform has none of them.
+			continue;
+		}
+		if (!devices.empty())
+			break;
+	}
+	if (devices.empty())
+	{
+		throw Error(CL_DEVICE_NOT_FOUND, "no OpenCL device of the requested type");
+	}
+	_device = devices[0];
+	devices.resize(1);
+
+	_context = Context(devices);
+	_queue = CommandQueue(_context, _device);
+
+	// Read in kernel source
+	ifstream file(kernel_path);
+	if (!file)
+	{
+		throw Error(CL_INVALID_VALUE, "could not open sha256_mine.cl");
+	}
+	string code(istreambuf_iterator<char>(file), (istreambuf_iterator<char>()));
+	Program::Sources source(1, make_pair(code.c_str(), code.length() + 1));
+	_program = Program(_context, source);
+	try
+	{
+		_program.build(devices);
+	}
+	catch (const Error &)
+	{
+		cout << _program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(_device) << endl;
+		throw;
+	}
+	_kernel = Kernel(_program, "sha256_mine");
+
+	_midstate = Buffer(_context, CL_MEM_READ_ONLY, 8 * sizeof(cl_uint));
+	_prefix = Buffer(_context, CL_MEM_READ_ONLY, MAX_MESSAGE_BYTES);
+	_suffix = Buffer(_context, CL_MEM_READ_ONLY, MAX_MESSAGE_BYTES);
+	_winner = Buffer(_context, CL_MEM_READ_WRITE, sizeof(cl_uint));
+}
+
+string opencl_strategy::device_name() const
+{
+	return _device.getInfo<CL_DEVICE_NAME>();
+}
+
+void opencl_strategy::mine(const mining_job &job, mining_outcome &outcome)
+{
+	// The device counts as a single worker, driven from this thread.
+	outcome.size_workers(1);
+	worker_counters &counters = outcome.workers[0];
+
+	// The kernel finishes the hash in private memory of a fixed size.
+	// Anything longer is left to the CPU.
+	size_t prefix_length = job.midstate.pending_length();
+	if (prefix_length + MAX_NONCE_DIGITS + job.suffix.length() + PADDING_BYTES > MAX_MESSAGE_BYTES)
+	{
+		search_stride(job, job.first_nonce, job.nonce_spacing, outcome);
+		return;
+	}
+
+	// Everything but the nonce is the same for the whole block.
+	_queue.enqueueWriteBuffer(_midstate, CL_TRUE, 0, 8 * sizeof(cl_uint), job.midstate.chaining_value());
+	if (prefix_length > 0)
+		_queue.enqueueWriteBuffer(_prefix, CL_TRUE, 0, prefix_length, job.midstate.pending());
+	if (!job.suffix.empty())
+		_queue.enqueueWriteBuffer(_suffix, CL_TRUE, 0, job.suffix.length(), job.suffix.data());
+	_kernel.setArg(0, _midstate);
+	_kernel.setArg(1, _prefix);
+	_kernel.setArg(2, static_cast<cl_uint>(prefix_length));
+	_kernel.setArg(3, _suffix);
+	_kernel.setArg(4, static_cast<cl_uint>(job.suffix.length()));
+	_kernel.setArg(5, static_cast<cl_ulong>(job.midstate.compressed_length()));
+	_kernel.setArg(7, static_cast<cl_ulong>(job.nonce_spacing));
+	_kernel.setArg(8, static_cast<cl_uint>(job.difficulty));
+	_kernel.setArg(9, _winner);
+
+	counters.begin = chrono::steady_clock::now();
+	uint64_t first = job.first_nonce;
+	size_t batch = FIRST_BATCH;
+	// Batches are short enough to check for cancelling between them.
+	while (!outcome.found.load() && !job.cancelled())
+	{
+		trace_scope scope("kernel batch");
+		// No winner reads as the largest id.
+		cl_uint winner = CL_UINT_MAX;
+		_queue.enqueueWriteBuffer(_winner, CL_TRUE, 0, sizeof(cl_uint), &winner);
+		counters.next_nonce.store(first, memory_order_relaxed);
+		_kernel.setArg(6, static_cast<cl_ulong>(first));
+		_queue.enqueueNDRangeKernel(_kernel, NullRange, NDRange(batch), NullRange);
+		_queue.enqueueReadBuffer(_winner, CL_TRUE, 0, sizeof(cl_uint), &winner);
+		counters.attempts += batch;
+
+		if (winner != CL_UINT_MAX)
+		{
+			// Only the id comes back, so redo the winner's hash here.
+			uint64_t nonce = first + static_cast<uint64_t>(winner) * job.nonce_spacing;
+			header_buffer tail;
+			tail.reset(nonce, job.suffix);
+			SHA256 ctx;
+			ctx.resume(job.midstate);
+			ctx.update(tail.data(), tail.length());
+			unsigned char digest[SHA256::DIGEST_SIZE];
+			ctx.final(digest);
+			outcome.publish(nonce, digest);
+			// The rest of the batch ran past the winner for nothing.
+			counters.wasted = batch - winner - 1;
+			counters.end = chrono::steady_clock::now();
+			return;
+		}
+
+		first += static_cast<uint64_t>(batch) * job.nonce_spacing;
+		if (batch < _max_batch)
+			batch *= 2;
+	}
+	counters.end = chrono::steady_clock::now();
+}
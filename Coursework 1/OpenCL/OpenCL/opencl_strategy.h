@@ -0,0 +1,43 @@
+#pragma once
+
+#define __CL_ENABLE_EXCEPTIONS
+// cl.hpp targets OpenCL 1.x; this keeps it building against newer
+// headers, such as the ones POCL installs.
+#define CL_TARGET_OPENCL_VERSION 120
+#define CL_USE_DEPRECATED_OPENCL_1_1_APIS
+
+#include <CL/cl.hpp>
+#include <string>
+
+#include "mining_strategy.h"
+
+// Searches for nonces with the sha256_mine.cl kernel, one nonce per
+// work-item.  The program, kernel and buffers are built once, when the
+// strategy is created, and reused for every block.  Each block is
+// searched in batches that start small, so easy blocks don't pay for
+// a huge launch, and double up to max_batch work-items.
+class opencl_strategy : public mining_strategy
+{
+private:
+	cl::Device _device;
+	cl::Context _context;
+	cl::CommandQueue _queue;
+	cl::Program _program;
+	cl::Kernel _kernel;
+	cl::Buffer _midstate;
+	cl::Buffer _prefix;
+	cl::Buffer _suffix;
+	cl::Buffer _winner;
+	size_t _max_batch;
+
+public:
+	// Uses the first device of the given type on any platform, such as
+	// CL_DEVICE_TYPE_CPU for POCL.  Throws cl::Error if there is no such
+	// device or the kernel fails to build (the build log is printed).
+	explicit opencl_strategy(cl_device_type type, const std::string &kernel_path = "sha256_mine.cl", size_t max_batch = 1 << 20);
+
+	const char *name() const noexcept override { return "opencl"; }
+	std::string device_name() const;
+
+	void mine(const mining_job &job, mining_outcome &outcome) override;
+};
@@ -0,0 +1,123 @@
+// Nonce search for the block chain miner.  Each work-item tries one
+// nonce: it finishes the block's SHA-256 from the midstate the host
+// worked out, then checks the digest against the difficulty.
+
+// Room for the uncompressed prefix bytes (under 64), the nonce's
+// digits, the suffix and the padding.  The host checks it all fits.
+#define MAX_BLOCKS 4
+
+__constant uint k[64] =
+    {0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+     0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+     0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+     0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+     0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+     0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+     0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+     0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+     0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+     0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+     0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+     0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+     0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+     0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+     0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+     0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+// rotate() turns left, SHA-256 wants right.
+#define ROTR(x, n) rotate((x), (uint)(32 - (n)))
+#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define F1(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define F2(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define F3(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define F4(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+// One SHA-256 compression of a 64 byte block into h.
+void compress(uint *h, const uchar *block)
+{
+    uint w[64];
+    for (int j = 0; j < 16; ++j)
+        w[j] = ((uint)block[j * 4] << 24) | ((uint)block[j * 4 + 1] << 16) | ((uint)block[j * 4 + 2] << 8) | (uint)block[j * 4 + 3];
+    for (int j = 16; j < 64; ++j)
+        w[j] = F4(w[j - 2]) + w[j - 7] + F3(w[j - 15]) + w[j - 16];
+
+    uint a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+    for (int j = 0; j < 64; ++j)
+    {
+        uint t1 = hh + F2(e) + CH(e, f, g) + k[j] + w[j];
+        uint t2 = F1(a) + MAJ(a, b, c);
+        hh = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += hh;
+}
+
+// midstate:          the chaining value after the whole blocks absorbed so far
+// prefix:            bytes absorbed but not yet compressed
+// compressed_length: bytes already compressed into midstate
+// suffix:            what follows the nonce in the header
+// Work-item i tries first_nonce + i * spacing.  Winners record their
+// id with atomic_min, so the host gets the lowest winning nonce of the
+// batch, just as a one-nonce-at-a-time search would.
+__kernel void sha256_mine(__constant uint *midstate, __constant uchar *prefix, uint prefix_length,
+                          __constant uchar *suffix, uint suffix_length, ulong compressed_length,
+                          ulong first_nonce, ulong spacing, uint difficulty, __global volatile uint *winner)
+{
+    uint id = get_global_id(0);
+    ulong nonce = first_nonce + id * spacing;
+
+    // Lay out prefix, nonce in decimal, suffix and the padding.
+    uchar message[MAX_BLOCKS * 64];
+    uint length = 0;
+    for (uint i = 0; i < prefix_length; ++i)
+        message[length++] = prefix[i];
+    uchar digits[20];
+    uint num_digits = 0;
+    do
+    {
+        digits[num_digits++] = (uchar)('0' + nonce % 10);
+        nonce /= 10;
+    } while (nonce != 0);
+    while (num_digits > 0)
+        message[length++] = digits[--num_digits];
+    for (uint i = 0; i < suffix_length; ++i)
+        message[length++] = suffix[i];
+
+    ulong bits = (compressed_length + length) * 8;
+    message[length++] = 0x80;
+    uint num_blocks = (length + 8 + 63) / 64;
+    while (length < num_blocks * 64 - 8)
+        message[length++] = 0;
+    for (int i = 7; i >= 0; --i)
+        message[length++] = (uchar)(bits >> (i * 8));
+
+    uint h[8];
+    for (int i = 0; i < 8; ++i)
+        h[i] = midstate[i];
+    for (uint b = 0; b < num_blocks; ++b)
+        compress(h, message + b * 64);
+
+    // The hex digest starts with difficulty '0's when that many
+    // leading nibbles of the state are zero.
+    uint zeros = min(difficulty, (uint)64);
+    for (uint i = 0; i < zeros; ++i)
+    {
+        if ((h[i / 8] >> (28 - 4 * (i % 8))) & 0xf)
+            return;
+    }
+    atomic_min(winner, id);
+}
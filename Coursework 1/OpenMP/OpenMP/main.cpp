@@ -3,36 +3,280 @@
 #include <chrono>
 #include <fstream>
 #include <thread>
+#include <atomic>
+#include <deque>
+#include <future>
 #include "block_chain.h"
+#include "mempool.h"
+#include "sha256.h"
+#include "sha256_multi.h"
+#include "affinity.h"
+#include "trace.h"
+#include <omp.h>
+#include <vector>
+#include <memory>
 
 using namespace std;
 using namespace chrono;
 
-int main()
+// Made-up transactions for block i, for trying out Merkle payloads.
+static vector<string> make_transactions(int i, unsigned int count)
+{
+	vector<string> transactions;
+	for (unsigned int t = 0; t < count; ++t)
+	{
+		transactions.push_back(string("Block ") + to_string(i) + string(" Tx ") + to_string(t));
+	}
+	return transactions;
+}
+
+// Mines blocks filled from a mempool rather than made up on the spot.
+// num_producers ingest threads keep pushing transactions, while this
+// thread assembles blocks of up to max_per_block of them.  One block is
+// always queued behind the one being mined, and the pool is drained
+// into the block after it meanwhile, so the miner never waits for a
+// block to be put together and ingest never waits for either.
+static void mine_from_mempool(block_chain &bchain, unsigned int num_producers, size_t max_per_block)
+{
+	mempool pool;
+	atomic<bool> stop(false);
+	vector<thread> producers;
+	for (unsigned int p = 0; p < num_producers; ++p)
+	{
+		producers.push_back(thread([&pool, &stop, p]
+		{
+			uint64_t n = 0;
+			while (!stop.load(memory_order_relaxed))
+			{
+				pool.push(string("Producer ") + to_string(p) + string(" Tx ") + to_string(n++));
+				// Roughly how fast transactions might turn up.
+				this_thread::sleep_for(microseconds(20));
+			}
+		}));
+	}
+
+	ofstream results("OpenMP_mempool.csv", ofstream::out);
+	results << "Average Block Time" << "," << "Difficulty" << "," << "Transactions" << endl;
+
+	for (uint32_t difficulty = 1; difficulty < 6; difficulty++)
+	{
+		auto start = system_clock::now();
+		deque<future<block_ref>> mining;
+		size_t total = 0;
+		for (uint32_t i = 1; i < 100u; ++i)
+		{
+			vector<string> transactions;
+			// Keep filling this block until the miner is down to the
+			// last block queued for it, then queue this one behind it.
+			while (true)
+			{
+				pool.drain(transactions, max_per_block - transactions.size());
+				if (mining.size() < 2)
+					break;
+				if (mining.front().wait_for(microseconds(100)) == future_status::ready)
+					mining.pop_front();
+			}
+			total += transactions.size();
+			// The miner has every core, so the root is built on this thread.
+			mining.push_back(bchain.add_block_async(block(i, transactions, 1), difficulty));
+		}
+		bchain.wait();
+		auto end = system_clock::now();
+		duration<double> diff = end - start;
+		results << diff.count() << "," << difficulty << "," << total << endl;
+	}
+	results.close();
+
+	stop = true;
+	for (auto &t : producers)
+	{
+		t.join();
+	}
+}
+
+// Mines the given number of independent chains side by side, each with its
+// own share of the cores, and records their combined throughput.
+static void mine_chains(unsigned int num_chains, bool nonce_last, const string &strategy, affinity_policy affinity)
+{
+	// Each chain is its own instance with its own prev_hash history, so
+	// nothing is shared between them (sharing one chain across the
+	// difficulty loop is what used to corrupt the heap).
+	vector<unique_ptr<block_chain>> chains;
+	for (unsigned int c = 0; c < num_chains; ++c)
+	{
+		vector<unsigned int> cpus = cpu_subset(c, num_chains);
+		unsigned int num_threads = static_cast<unsigned int>(cpus.size());
+		chains.emplace_back(new block_chain(make_strategy(strategy, num_threads)));
+		chains[c]->nonce_last = nonce_last;
+		chains[c]->cpus = cpus;
+		chains[c]->affinity = affinity;
+		chains[c]->num_threads = num_threads;
+	}
+
+	ofstream results("OpenMP_chains.csv", ofstream::out);
+	results << "Average Block Time" << "," << "Difficulty" << "," << "Chains" << "," << "Blocks Per Second" << endl;
+
+	// Each chain's miner opens its own parallel region inside ours.
+#if _OPENMP >= 200805
+	omp_set_max_active_levels(2);
+#else
+	omp_set_nested(1);
+#endif
+
+	for (int difficulty = 1; difficulty < 6; difficulty++)
+	{
+		auto start = system_clock::now();
+#pragma omp parallel for num_threads(num_chains) schedule(static, 1) default(none) shared(chains, num_chains, difficulty)
+		for (int c = 0; c < static_cast<int>(num_chains); ++c)
+		{
+			for (int i = 1; i < 100; ++i)
+			{
+				chains[c]->add_block(block(i, string("Block ") + to_string(i) + string(" Data")), difficulty);
+			}
+		}
+		auto end = system_clock::now();
+		duration<double> diff = end - start;
+		results << diff.count() << "," << difficulty << "," << num_chains << "," << (99.0 * num_chains) / diff.count() << endl;
+	}
+
+	results.close();
+}
+
+int main(int argc, char **argv)
 {
     block_chain bchain;
+	unsigned int num_chains = 0;
+	string strategy = "openmp";
+	string chain_path;
+	unsigned int num_transactions = 0;
+	unsigned int num_producers = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		// Passing --nonce-last switches to the midstate-friendly header layout.
+		// Hashes will differ from the original layout, so it is opt-in.
+		if (string(argv[i]) == "--nonce-last")
+			bchain.nonce_last = true;
+		// Passing --chains N mines N independent chains at once.
+		else if (string(argv[i]) == "--chains" && i + 1 < argc)
+			num_chains = static_cast<unsigned int>(stoul(argv[++i]));
+		// Passing --strategy NAME picks how mine_block searches.
+		else if (string(argv[i]) == "--strategy" && i + 1 < argc)
+			strategy = argv[++i];
+		// Passing --chain-file PATH keeps the chain on disk, picking
+		// up from wherever a previous run got to.
+		else if (string(argv[i]) == "--chain-file" && i + 1 < argc)
+			chain_path = argv[++i];
+		// Passing --transactions N gives each block N transactions
+		// summarised by a Merkle root, rather than a line of data.
+		else if (string(argv[i]) == "--transactions" && i + 1 < argc)
+			num_transactions = static_cast<unsigned int>(stoul(argv[++i]));
+		// Passing --mempool N fills blocks from a mempool fed by N
+		// ingest threads while mining goes on, up to --transactions
+		// (or 1024) per block.
+		else if (string(argv[i]) == "--mempool" && i + 1 < argc)
+			num_producers = static_cast<unsigned int>(stoul(argv[++i]));
+		// Passing --checkpoint PATH saves each block's search progress
+		// there, so a long block interrupted part way isn't started over.
+		else if (string(argv[i]) == "--checkpoint" && i + 1 < argc)
+			bchain.checkpoint_path = argv[++i];
+		// Passing --trace PATH records a timeline of mining, written
+		// there as Chrome trace JSON on exit.
+		else if (string(argv[i]) == "--trace" && i + 1 < argc)
+			trace_to_file(argv[++i]);
+		// Passing --affinity POLICY (compact, scatter or physical) pins
+		// each mining thread to a CPU of its own.
+		else if (string(argv[i]) == "--affinity" && i + 1 < argc)
+		{
+			if (!parse_affinity_policy(argv[++i], bchain.affinity))
+			{
+				cout << "Unknown affinity policy " << argv[i] << endl;
+				return 1;
+			}
+		}
+	}
+	if (!make_strategy(strategy))
+	{
+		cout << "Unknown strategy " << strategy << ", expected one of:";
+		for (auto &name : strategy_names())
+			cout << " " << name;
+		cout << endl;
+		return 1;
+	}
+	bchain.set_strategy(make_strategy(strategy));
+	// Record which hashing code this machine ended up using.
+	cout << "SHA-256 backend: " << sha256_backend() << ", multi-buffer engine: " << sha256_multi_engine() << ", strategy: " << strategy << endl;
+
+	if (num_chains > 0)
+	{
+		mine_chains(num_chains, bchain.nonce_last, strategy, bchain.affinity);
+		return 0;
+	}
+
+	if (num_producers > 0)
+	{
+		mine_from_mempool(bchain, num_producers, num_transactions > 0 ? num_transactions : 1024);
+		return 0;
+	}
+
+	// Blocks already in the chain file don't need mining again.
+	size_t resume_from = 0;
+	if (!chain_path.empty())
+	{
+		auto start = system_clock::now();
+		if (!bchain.open(chain_path))
+		{
+			cout << "Could not open chain file " << chain_path << endl;
+			return 1;
+		}
+		duration<double> diff = system_clock::now() - start;
+		resume_from = bchain.size() - 1;
+		cout << "Loaded " << bchain.size() << " blocks from " << chain_path << " in " << diff.count() << " seconds" << endl;
+
+		// Don't build on top of a chain that has been tampered with.
+		start = system_clock::now();
+		size_t invalid = bchain.validate();
+		diff = system_clock::now() - start;
+		if (invalid != bchain.size())
+		{
+			cout << "Chain file " << chain_path << " is invalid from block " << invalid << endl;
+			return 1;
+		}
+		cout << "Validated in " << diff.count() << " seconds" << endl;
+	}
+
 	// Open a file in the root folder,
 	bchain.results.open("OpenMP.csv", ofstream::out);
 	// And add the headings for average block time and difficulty.
 	bchain.results << "Average Block Time" << "," << "Difficulty" << endl;
 
-	// If uncommented, this line will attempt to run multiple difficulties at once.
-	// Unfortunately, there is an issue which stems from the previous_hash
-	// dependence, which causes heap corruption issues.
-//#pragma omp parallel for num_threads(8) default(none)
+	// One chain mining one difficulty after another.  See --chains
+	// for running several independent chains concurrently.
+	size_t block_count = 0;
 	for (int difficulty = 1; difficulty < 6; difficulty++)
 	{
 		auto start = system_clock::now();
 		for (int i = 1; i < 100u; ++i)
 		{
-			bchain.add_block(block(i, string("Block ") + to_string(i) + string(" Data")), difficulty);
+			if (block_count++ < resume_from)
+				continue;
+			if (num_transactions > 0)
+				bchain.add_block(block(i, make_transactions(i, num_transactions)), difficulty);
+			else
+				bchain.add_block(block(i, string("Block ") + to_string(i) + string(" Data")), difficulty);
 		}
 		auto end = system_clock::now();
 		duration<double> diff = end - start;
-		bchain.results << diff.count() << "," << difficulty << endl;
+		// Difficulties finished by an earlier run have nothing to report.
+		if (block_count > resume_from)
+			bchain.results << diff.count() << "," << difficulty << endl;
 	}
 	
 	bchain.results.close();
 
+	// Block times per difficulty, with each bucket's attempts and idling,
+	// to tell unlucky blocks from ones that scaled badly.
+	ofstream histograms("OpenMP_histogram.csv", ofstream::out);
+	bchain.stats().write_histograms(histograms);
+
     return 0;
 }
\ No newline at end of file